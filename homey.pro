@@ -1,6 +1,6 @@
 TEMPLATE  = lib
 CONFIG   += c++14 plugin
-QT       += websockets core quick
+QT       += websockets network core gui quick
 
 # === Version and build information ===========================================
 # If built in Buildroot use custom package version, otherwise Git
@@ -76,8 +76,7 @@ unix {
 QMAKE_SUBSTITUTES += homey.json.in version.txt.in
 # output path must be included for the output file from QMAKE_SUBSTITUTES
 INCLUDEPATH += $$OUT_PWD
-HEADERS  += src/homey.h
-SOURCES  += src/homey.cpp
+include(src/homey.pri)
 TARGET    = homey
 
 # Configure destination path. DESTDIR is set in qmake-destination-path.pri
@@ -24,11 +24,19 @@
 
 #include "homey.h"
 
+#include <algorithm>
+
+#include <QDir>
+#include <QElapsedTimer>
 #include <QJsonArray>
 #include <QJsonDocument>
+#include <QJsonObject>
+#include <QSettings>
+#include <QStandardPaths>
 #include <QtDebug>
 
-#include "math.h"
+#include "homeyhubs.h"
+#include "homeyrequesttracker.h"
 #include "yio-interface/entities/blindinterface.h"
 #include "yio-interface/entities/climateinterface.h"
 #include "yio-interface/entities/lightinterface.h"
@@ -42,6 +50,19 @@ Integration *HomeyPlugin::createIntegration(const QVariantMap &config, EntitiesI
                                             ConfigInterface *configObj) {
     qCInfo(m_logCategory) << "Creating Homey integration plugin" << PLUGIN_VERSION;
 
+    // several hubs only with a non-empty list of hub settings, otherwise the settings of a single hub are used
+    QVariantMap data = config.value(Integration::OBJ_DATA).toMap();
+    if (data.contains("hubs")) {
+        QVariant hubs = data.value("hubs");
+        bool     valid = hubs.type() == QVariant::List && !hubs.toList().isEmpty();
+        for (const QVariant &hub : hubs.toList()) {
+            valid = valid && hub.type() == QVariant::Map;
+        }
+        if (valid) {
+            return new HomeyHubs(config, entities, notifications, api, configObj, this);
+        }
+        qCWarning(m_logCategory) << "Ignoring empty or invalid Homey hubs setting, using a single hub:" << hubs;
+    }
     return new Homey(config, entities, notifications, api, configObj, this);
 }
 
@@ -51,28 +72,92 @@ Integration *HomeyPlugin::createIntegration(const QVariantMap &config, EntitiesI
 
 Homey::Homey(const QVariantMap &config, EntitiesInterface *entities, NotificationsInterface *notifications,
              YioAPIInterface *api, ConfigInterface *configObj, Plugin *plugin)
-    : Integration(config, entities, notifications, api, configObj, plugin) {
+    : Integration(config, entities, notifications, api, configObj, plugin),
+      m_backoff(RECONNECT_MIN_DELAY, RECONNECT_MAX_DELAY) {
+    int     updateInterval = DEFAULT_UPDATE_INTERVAL;
+    int     commandInterval = DEFAULT_COMMAND_INTERVAL;
+    int     commandTimeout = DEFAULT_COMMAND_TIMEOUT;
+    int     port = DEFAULT_PORT;
+    int     metricsInterval = 0;
+    int     pingInterval = DEFAULT_PING_INTERVAL;
+    int     albumArtSize = DEFAULT_ALBUM_ART_SIZE;
+    bool    mdns = true;
+    QString mdnsAddress = DEFAULT_MDNS_ADDRESS;
+    int     mdnsPort = DEFAULT_MDNS_PORT;
+    QString cachePath;
     for (QVariantMap::const_iterator iter = config.begin(); iter != config.end(); ++iter) {
         if (iter.key() == Integration::OBJ_DATA) {
             QVariantMap map = iter.value().toMap();
             m_ip = map.value(Integration::KEY_DATA_IP).toString();
             m_token = map.value(Integration::KEY_DATA_TOKEN).toString();
+            port = map.value("port", DEFAULT_PORT).toInt();
+            updateInterval = map.value("update_interval", DEFAULT_UPDATE_INTERVAL).toInt();
+            commandInterval = map.value("command_interval", DEFAULT_COMMAND_INTERVAL).toInt();
+            commandTimeout = map.value("command_timeout", DEFAULT_COMMAND_TIMEOUT).toInt();
+            cachePath = map.value("cache_path").toString();
+            metricsInterval = map.value("metrics_interval", 0).toInt();
+            pingInterval = map.value("ping_interval", DEFAULT_PING_INTERVAL).toInt();
+            albumArtSize = map.value("album_art_size", DEFAULT_ALBUM_ART_SIZE).toInt();
+            mdns = map.value("mdns", true).toBool();
+            mdnsAddress = map.value("mdns_address", DEFAULT_MDNS_ADDRESS).toString();
+            mdnsPort = map.value("mdns_port", DEFAULT_MDNS_PORT).toInt();
+            m_hubId = map.value("hub").toString();
         }
     }
 
-    m_api = api;
-    m_url = QString("ws://").append(m_ip).append(QString(":8936"));
+    // hub of a multi-hub integration: entity IDs and cache files are namespaced with the hub id
+    QString storageId = integrationId();
+    if (!m_hubId.isEmpty()) {
+        m_entityPrefix = m_hubId + HUB_SEPARATOR;
+        storageId += '-' + m_hubId;
+    }
 
-    // FIXME magic number
-    m_webSocketId = 4;
+    if (cachePath.isEmpty()) {
+        cachePath = QStandardPaths::writableLocation(QStandardPaths::CacheLocation);
+    }
+    m_snapshot = HomeySnapshot(QDir(cachePath).filePath(QString("homey-%1.snapshot").arg(storageId)));
+    m_endpointFile = QDir(cachePath).filePath(QString("homey-%1.endpoint").arg(storageId));
+
+    if (albumArtSize > 0) {
+        m_albumArt = new HomeyAlbumArtCache(QDir(cachePath).filePath(QString("homey-%1-art").arg(storageId)),
+                                            QSize(albumArtSize, albumArtSize), ALBUM_ART_CACHE_BYTES, this);
+        QObject::connect(m_albumArt, &HomeyAlbumArtCache::ready, this, &Homey::onAlbumArtReady);
+    }
+
+    m_api = api;
+    m_url = QString("ws://%1:%2").arg(m_ip).arg(port);
+    m_clock.start();
 
     m_wsReconnectTimer = new QTimer(this);
     m_wsReconnectTimer->setSingleShot(true);
-    m_wsReconnectTimer->setInterval(2000);
     m_wsReconnectTimer->stop();
 
+    m_updateTimer = new QTimer(this);
+    m_updateTimer->setSingleShot(true);
+    m_updateTimer->setInterval(updateInterval);
+
+    m_commandQueue = new HomeyCommandQueue(commandInterval, this);
+    m_requests = new HomeyRequestTracker(commandTimeout, this);
+
+    m_snapshotTimer = new QTimer(this);
+    m_snapshotTimer->setSingleShot(true);
+    m_snapshotTimer->setInterval(SNAPSHOT_INTERVAL);
+
+    m_registrationTimer = new QTimer(this);
+    m_registrationTimer->setSingleShot(true);
+    m_registrationTimer->setInterval(0);
+
+    // optional periodic metrics dump
+    m_metricsTimer = new QTimer(this);
+    m_metricsTimer->setInterval(metricsInterval * 1000);
+    if (metricsInterval > 0) {
+        m_metricsTimer->start();
+    }
+
     m_webSocket = new QWebSocket;
     m_webSocket->setParent(this);
+    m_outbox = new HomeyOutbox(m_webSocket, OUTBOX_LOW_WATER, OUTBOX_BULK_LIMIT, this);
+    m_linkMonitor = new HomeyLinkMonitor(m_webSocket, pingInterval, PING_TIMEOUT, this);
 
     QObject::connect(m_webSocket, &QWebSocket::textFrameReceived, this, &Homey::onTextMessageReceived);
     QObject::connect(m_webSocket, static_cast<void (QWebSocket::*)(QAbstractSocket::SocketError)>(&QWebSocket::error),
@@ -80,320 +165,1129 @@ Homey::Homey(const QVariantMap &config, EntitiesInterface *entities, Notificatio
     QObject::connect(m_webSocket, &QWebSocket::stateChanged, this, &Homey::onStateChanged);
 
     QObject::connect(m_wsReconnectTimer, &QTimer::timeout, this, &Homey::onTimeout);
+    QObject::connect(m_updateTimer, &QTimer::timeout, this, &Homey::onUpdateTimeout);
+    QObject::connect(m_commandQueue, &HomeyCommandQueue::send, this, &Homey::webSocketSendCommand);
+    QObject::connect(m_requests, &HomeyRequestTracker::resend, this, &Homey::onRequestResend);
+    QObject::connect(m_requests, &HomeyRequestTracker::lost, this, &Homey::onRequestLost);
+    QObject::connect(m_snapshotTimer, &QTimer::timeout, this, &Homey::saveSnapshot);
+    QObject::connect(m_registrationTimer, &QTimer::timeout, this, &Homey::onRegistrationTimeout);
+    QObject::connect(m_metricsTimer, &QTimer::timeout, this, &Homey::onMetricsTimeout);
+    if (mdns) {
+        m_discovery = new HomeyServiceBrowser(MDNS_SERVICE, QHostAddress(mdnsAddress), static_cast<quint16>(mdnsPort),
+                                              this);
+        QObject::connect(m_discovery, &HomeyServiceBrowser::endpointFound, this, &Homey::onEndpointFound);
+
+        // endpoint of the last session: connect right away, it is refreshed in the background
+        QSettings endpoint(m_endpointFile, QSettings::IniFormat);
+        QString   host = endpoint.value("host").toString();
+        if (!host.isEmpty() && (m_ip.isEmpty() || host.compare(m_ip, Qt::CaseInsensitive) == 0 ||
+                                QHostAddress(m_ip) == QHostAddress(endpoint.value("address").toString()))) {
+            m_address = QHostAddress(endpoint.value("address").toString());
+            m_endpointPort = static_cast<quint16>(endpoint.value("port").toUInt());
+        }
+    }
+
+    QObject::connect(m_linkMonitor, &HomeyLinkMonitor::dead, this, &Homey::onLinkDead);
+    QObject::connect(m_linkMonitor, &HomeyLinkMonitor::roundTripTime, this,
+                     [this](qint64 ms) { m_metrics.pingTime.add(ms); });
 }
 
 void Homey::onTextMessageReceived(const QString &message) {
+    m_linkMonitor->alive();
+
+    QByteArray utf8 = message.toUtf8();
+    m_metrics.bytesIn += static_cast<quint64>(utf8.size());
+
+    if (m_standby) {
+        if (deferEvent(utf8)) {
+            return;
+        }
+        // keep the arrival order: the deferred events are older than the states of this message
+        decodeDeferredEvents();
+    }
+
+    QElapsedTimer parseTimer;
+    parseTimer.start();
     QJsonParseError parseerror;
-    QJsonDocument   doc = QJsonDocument::fromJson(message.toUtf8(), &parseerror);
+    QJsonDocument   doc = QJsonDocument::fromJson(utf8, &parseerror);
+    m_metrics.parseTime.add(parseTimer.nsecsElapsed() / 1000);
     if (parseerror.error != QJsonParseError::NoError) {
         qCCritical(m_logCategory) << "JSON error:" << parseerror.errorString();
         return;
     }
-    QVariantMap map = doc.toVariant().toMap();
+    // work on the JSON object directly: converting the whole document to a QVariantMap deep copies every message
+    QJsonObject root = doc.object();
+
+    QJsonValue error = root.value(QLatin1String("error"));
+    if (!error.isUndefined() && !error.isNull()) {
+        QString m = error.toVariant().toString();
+        if (m.length() > 0) {
+            qCCritical(m_logCategory) << "Message error:" << m;
+        }
+    }
+
+    MessageType type = messageType(root.value(QLatin1String("type")).toString());
+    m_metrics.messages[type]++;
 
-    QString m = map.value("error").toString();
-    if (m.length() > 0) {
-        qCCritical(m_logCategory) << "Message error:" << m;
+    switch (type) {
+        case MSG_EVENT: {
+            HomeyStateUpdate update = HomeyStateUpdate::fromJson(root.value(QLatin1String("data")).toObject());
+            // Without command results from the Homey app the resulting event acknowledges the command. With them any
+            // unrelated event of the device would complete the command and defeat the retries.
+            if (!(m_serverFeatures & FEATURE_COMMAND_RESULT) && m_requests->inFlight() > 0) {
+                m_requests->acknowledgeDevice(update.entityId);
+            }
+            queueUpdate(update);
+            break;
+        }
+        case MSG_SEND_STATES:
+            // handle fetch states from homey app
+            queueUpdate(HomeyStateUpdate::fromJson(root.value(QLatin1String("data")).toObject()));
+            break;
+        case MSG_RESULT:
+            m_requests->acknowledge(root.value(QLatin1String("id")).toInt());
+            break;
+        case MSG_SEND_STATES_BATCH:
+            // all device states in one message
+            queueUpdates(root.value(QLatin1String("data")).toArray());
+            break;
+        case MSG_CONNECTED:
+            m_serverFeatures = serverFeatures(root.value(QLatin1String("features")).toArray());
+            // a new connection starts unfiltered
+            m_subscription.clear();
+            sendSubscription();
+            if (m_disconnectedSince.isValid()) {
+                m_metrics.reconnectTime.add(m_disconnectedSince.elapsed());
+                m_disconnectedSince.invalidate();
+            }
+            m_backoff.reset();
+            m_reconnectNotified = false;
+            if (m_standby) {
+                // reconnected in standby: the new session doesn't know, no pings until leaveStandby
+                sendStandby();
+            } else {
+                m_linkMonitor->start();
+            }
+            setState(CONNECTED);
+            break;
+        case MSG_COMMAND:
+            if (root.value(QLatin1String("command")).toString() == QLatin1String("getEntities")) {
+                sendEntityIds();
+            }
+            break;
+        case MSG_SEND_ENTITIES:
+            // get all the entities from the homey app
+            addEntities(root.value(QLatin1String("available_entities")).toArray());
+            break;
+        case MSG_UNKNOWN:
+            break;
     }
+}
 
-    QString type = map.value("type").toString();
+quint32 Homey::serverFeatures(const QJsonArray &features) {
+    quint32 result = 0;
+    for (const QJsonValue &feature : features) {
+        if (feature.toString() == QLatin1String("delta_sync")) {
+            result |= FEATURE_DELTA_SYNC;
+        } else if (feature.toString() == QLatin1String("command_result")) {
+            result |= FEATURE_COMMAND_RESULT;
+        } else if (feature.toString() == QLatin1String("subscribe")) {
+            result |= FEATURE_SUBSCRIBE;
+        } else if (feature.toString() == QLatin1String("standby")) {
+            result |= FEATURE_STANDBY;
+        }
+    }
+    return result;
+}
 
-    if (type == "connected") {
-        setState(CONNECTED);
+Homey::MessageType Homey::messageType(const QString &type) {
+    if (type == QLatin1String("event")) {
+        return MSG_EVENT;
+    }
+    if (type == QLatin1String("sendStates")) {
+        return MSG_SEND_STATES;
+    }
+    if (type == QLatin1String("sendStatesBatch")) {
+        return MSG_SEND_STATES_BATCH;
+    }
+    if (type == QLatin1String("result")) {
+        return MSG_RESULT;
+    }
+    if (type == QLatin1String("connected")) {
+        return MSG_CONNECTED;
+    }
+    if (type == QLatin1String("command")) {
+        return MSG_COMMAND;
+    }
+    if (type == QLatin1String("sendEntities")) {
+        return MSG_SEND_ENTITIES;
     }
+    return MSG_UNKNOWN;
+}
 
-    if (type == "command" && map.value("command").toString() == "getEntities") {
-        // get loaded homey entities
-        QList<EntityInterface *> es = m_entities->getByIntegration(integrationId());
+void Homey::sendEntityIds() {
+    // Entities loaded in the settings don't notify the integration: a cheap check of the entity IDs, the handles and
+    // the serialized list are only rebuilt if they changed. Removed entities are handled by onEntityDestroyed.
+    QList<EntityInterface *> entities = loadedEntities();
+    if (!hasEntityIds(entities)) {
+        rebuildEntityHandles(entities);
+        setEntityIds(entities);
+    }
 
-        // create return map object
-        QVariantMap returnData;
+    if (m_serverFeatures & FEATURE_DELTA_SYNC) {
+        // revisions change with every event: appended to a copy of the cached reply
+        QByteArray reply = entitiesReply();
+        reply.chop(1);
+        reply.append(",\"revisions\":{");
+        int count = 0;
+        for (const QString &entityId : m_entityIds) {
+            QHash<QString, qint64>::const_iterator revision = m_revisions.constFind(entityId);
+            if (revision != m_revisions.constEnd()) {
+                if (count++ > 0) {
+                    reply.append(',');
+                }
+                HomeyCommandTemplate::appendString(&reply, entityId);
+                reply.append(':').append(QByteArray::number(revision.value()));
+            }
+        }
+        reply.append("}}");
+        qCDebug(m_logCategory) << "Requesting delta sync for" << count << "of" << m_entityIds.size() << "devices";
 
-        // set type
-        returnData.insert("type", "getEntities");
+        m_outbox->send(reply, HomeyOutbox::BULK, "getEntities");
+    } else {
+        // send message: background traffic, must not delay commands. Only the latest reply is of interest.
+        m_outbox->send(entitiesReply(), HomeyOutbox::BULK, "getEntities");
+    }
 
-        // create list to store entity ids
-        QStringList list;
+    sendSubscription();
+}
 
-        // interate throug the list and get the entity ids
+bool Homey::hasEntityIds(const QList<EntityInterface *> &entities) const {
+    if (entities.size() != m_entityIds.size()) {
+        return false;
+    }
+    for (EntityInterface *entity : entities) {
+        if (!m_entityIdSet.contains(deviceId(entity->entity_id()))) {
+            return false;
+        }
+    }
+    return true;
+}
 
-        for (EntityInterface *value : es) {
-            list.append(value->entity_id());
-            qCDebug(m_logCategory) << value->entity_id();
+void Homey::setEntityIds(const QList<EntityInterface *> &entities) {
+    QStringList added;
+    for (EntityInterface *entity : entities) {
+        const QString entityId = deviceId(entity->entity_id());
+        if (!m_entityIdSet.contains(entityId)) {
+            added.append(entityId);
         }
-        qCDebug(m_logCategory) << "LIST" << list;
-        // insert list to data key in response
-        returnData.insert("devices", list);
+    }
+    if (m_entityIds.size() + added.size() == entities.size()) {
+        for (const QString &entityId : added) {
+            addEntityId(entityId);
+        }
+        return;
+    }
+
+    // entities were removed: serialize the list again
+    m_entityIds.clear();
+    m_entityIdSet.clear();
+    m_deviceList.clear();
+    m_entitiesReply.clear();
+    for (EntityInterface *entity : entities) {
+        addEntityId(deviceId(entity->entity_id()));
+    }
+}
+
+void Homey::addEntityId(const QString &entityId) {
+    if (!m_deviceList.isEmpty()) {
+        m_deviceList.append(',');
+    }
+    HomeyCommandTemplate::appendString(&m_deviceList, entityId);
+    m_entityIds.append(entityId);
+    m_entityIdSet.insert(entityId);
+    m_entitiesReply.clear();
+}
 
-        // convert map to json
-        QJsonDocument doc = QJsonDocument::fromVariant(returnData);
-        QString       message = doc.toJson(QJsonDocument::JsonFormat::Compact);
+void Homey::removeEntityId(const QString &entityId) {
+    if (!m_entityIdSet.remove(entityId)) {
+        return;
+    }
+    m_entityIds.removeOne(entityId);
 
-        // send message
-        if (m_webSocket->isValid()) {
-            m_webSocket->sendTextMessage(message);
+    // the serialized list can't be cut cheaply, removals are rare
+    m_deviceList.clear();
+    for (const QString &id : m_entityIds) {
+        if (!m_deviceList.isEmpty()) {
+            m_deviceList.append(',');
         }
+        HomeyCommandTemplate::appendString(&m_deviceList, id);
     }
+    m_entitiesReply.clear();
+}
 
-    // get all the entities from the homey app
-    if (type == "sendEntities") {
-        QVariantList availableEntities = map.value("available_entities").toList();
+const QByteArray &Homey::entitiesReply() {
+    if (m_entitiesReply.isEmpty()) {
+        // Announce optional protocol features, older Homey app versions ignore them:
+        // - batch_states: initial states may be sent in one sendStatesBatch message instead of one message per device
+        // - delta_sync: only send the states of devices changed since the given revisions
+        // - command_result: commands carry an "id", answer with a result message {"type":"result","id":<id>}
+        // - subscribe: a subscribe message limits the events to the loaded devices and their mapped capabilities
+        // - standby: no events after a standby message until a resume message, answered with the changed states
+        static const char HEAD[] =
+            "{\"type\":\"getEntities\","
+            "\"features\":[\"batch_states\",\"delta_sync\",\"command_result\",\"subscribe\",\"standby\"],"
+            "\"devices\":[";
+        m_entitiesReply.reserve(static_cast<int>(sizeof(HEAD)) + m_deviceList.size() + 2);
+        m_entitiesReply.append(HEAD).append(m_deviceList).append("]}");
+    }
+    return m_entitiesReply;
+}
 
-        for (int i = 0; i < availableEntities.length(); i++) {
-            // add entity to allAvailableEntities list
-            QVariantMap entity = availableEntities[i].toMap();
-            entity.insert("integration", integrationId());
-            if (!addAvailableEntity(entity.value("entity_id").toString(), entity.value("type").toString(),
-                                    entity.value("integration").toString(), entity.value("friendly_name").toString(),
-                                    entity.value("supported_features").toStringList())) {
-                qCWarning(m_logCategory) << "Failed to add entity to the available entities list:"
-                                         << entity.value("entity_id").toString();
-            }
+void Homey::sendSubscription() {
+    // Without subscription support the Homey app streams the events of all devices. An empty subscription would
+    // stop all events: stay unfiltered until entities are loaded.
+    if (!(m_serverFeatures & FEATURE_SUBSCRIBE) || m_entityHandles.isEmpty()) {
+        return;
+    }
 
-            // create an entity
-            if (!m_api->addEntity(entity)) {
-                qCWarning(m_logCategory) << "Failed to create entity, it could already exist:"
-                                         << entity.value("entity_id").toString();
+    // {"type":"subscribe","devices":{"<deviceId>":["onoff","dim",...],...}}
+    QJsonObject devices;
+    for (QHash<QString, EntityHandle>::const_iterator it = m_entityHandles.constBegin();
+         it != m_entityHandles.constEnd(); ++it) {
+        const EntityHandle &handle = it.value();
+        if (!handle.entity || handle.kind == KIND_UNKNOWN) {
+            continue;
+        }
+
+        // only the capabilities mapped to the entity and supported by it
+        QJsonArray capabilities;
+        for (int bit = 0; bit < HomeyStateUpdate::CAPABILITY_COUNT; bit++) {
+            const HomeyCapabilityMap::Attribute *mapping = HomeyCapabilityMap::attribute(handle.kind, bit);
+            if (mapping && (mapping->feature < 0 || handle.isSupported(mapping->feature))) {
+                capabilities.append(QLatin1String(HomeyStateUpdate::capabilityName(bit)));
             }
         }
+        devices.insert(it.key(), capabilities);
+    }
+
+    QJsonObject subscription;
+    subscription.insert(QLatin1String("type"), QLatin1String("subscribe"));
+    subscription.insert(QLatin1String("devices"), devices);
+
+    QByteArray message = QJsonDocument(subscription).toJson(QJsonDocument::JsonFormat::Compact);
+    if (message == m_subscription) {
+        return;
+    }
+
+    qCDebug(m_logCategory) << "Subscribing to" << devices.size() << "devices";
+    if (m_outbox->send(message, HomeyOutbox::BULK, "subscribe")) {
+        m_subscription = message;
+    }
+}
+
+void Homey::addEntities(const QJsonArray &availableEntities) {
+    m_catalog.clear();
+    m_catalog.reserve(availableEntities.size());
+
+    QSet<QString> devices;
+    for (const QJsonValue &value : availableEntities) {
+        QVariantMap entity = value.toObject().toVariantMap();
+        entity.insert("integration", integrationId());
+        devices.insert(entity.value("entity_id").toString());
+        m_catalog.append(entity);
+    }
+
+    // Reconcile with the entities registered from the snapshot or an earlier catalog: entities of devices gone from
+    // Homey are removed, unchanged ones are skipped by registerEntity.
+    for (QHash<QString, QVariantMap>::iterator it = m_registered.begin(); it != m_registered.end();) {
+        if (devices.contains(it.key())) {
+            ++it;
+            continue;
+        }
+        qCInfo(m_logCategory) << "Removing the entity of" << it.key() << ": no longer available on Homey";
+        m_api->removeEntity(entityId(it.key()));
+        it = m_registered.erase(it);
+    }
+
+    // last known states and revisions of the removed devices
+    for (QHash<QString, HomeyStateUpdate>::iterator it = m_lastStates.begin(); it != m_lastStates.end();) {
+        if (devices.contains(it.key())) {
+            ++it;
+        } else {
+            it = m_lastStates.erase(it);
+        }
+    }
+    for (QHash<QString, qint64>::iterator it = m_revisions.begin(); it != m_revisions.end();) {
+        if (devices.contains(it.key())) {
+            ++it;
+        } else {
+            it = m_revisions.erase(it);
+        }
+    }
+
+    startEntityRegistration();
+    scheduleSnapshot();
+}
+
+void Homey::startEntityRegistration() {
+    m_registrationTimer->stop();
+    m_registeredEntities = 0;
+    m_unavailableEntities.clear();
+    m_duplicateEntities.clear();
+
+    emit registrationProgressChanged();
+    onRegistrationTimeout();
+}
+
+void Homey::onRegistrationTimeout() {
+    // Register entities in time slices: large Homey installations would otherwise block the event loop and the
+    // cross-thread UI updates for the whole catalog.
+    QElapsedTimer slice;
+    slice.start();
+
+    while (m_registeredEntities < m_catalog.size()) {
+        registerEntity(m_catalog.at(m_registeredEntities).toMap());
+        m_registeredEntities++;
+
+        if (m_registeredEntities < m_catalog.size() && slice.elapsed() >= REGISTRATION_SLICE) {
+            emit registrationProgressChanged();
+            m_registrationTimer->start();
+            return;
+        }
     }
 
-    // handle fetch states from homey app
-    if (type == "sendStates") {
-        QVariantMap data = map.value("data").toMap();
-        updateEntity(data.value("entity_id").toString(), data);
+    emit registrationProgressChanged();
+
+    if (!m_unavailableEntities.isEmpty()) {
+        qCWarning(m_logCategory) << "Failed to add" << m_unavailableEntities.size()
+                                 << "entities to the available entities list:" << m_unavailableEntities;
     }
+    if (!m_duplicateEntities.isEmpty()) {
+        qCWarning(m_logCategory) << "Failed to create" << m_duplicateEntities.size()
+                                 << "entities, they could already exist:" << m_duplicateEntities;
+    }
+    m_unavailableEntities.clear();
+    m_duplicateEntities.clear();
+
+    // resolve the new entities once instead of for every event
+    QList<EntityInterface *> entities = loadedEntities();
+    rebuildEntityHandles(entities);
+    setEntityIds(entities);
+    sendSubscription();
+
+    // apply the states received during registration
+    m_updateTimer->stop();
+    onUpdateTimeout();
+}
 
-    if (type == "event") {
-        QVariantMap data = map.value("data").toMap();
-        updateEntity(data.value("entity_id").toString(), data);
+QList<EntityInterface *> Homey::loadedEntities() {
+    QList<EntityInterface *> entities = m_entities->getByIntegration(integrationId());
+    if (!m_entityPrefix.isEmpty()) {
+        // the other hubs of the integration
+        entities.erase(std::remove_if(entities.begin(), entities.end(),
+                                      [this](EntityInterface *entity) {
+                                          return !entity->entity_id().startsWith(m_entityPrefix);
+                                      }),
+                       entities.end());
+    }
+    return entities;
+}
+
+QString Homey::entityId(const QString &deviceId) const {
+    return m_entityPrefix.isEmpty() ? deviceId : m_entityPrefix + deviceId;
+}
+
+QString Homey::deviceId(const QString &entityId) const {
+    return m_entityPrefix.isEmpty() ? entityId : entityId.mid(m_entityPrefix.size());
+}
+
+void Homey::registerEntity(const QVariantMap &catalogEntity) {
+    const QString                               device = catalogEntity.value("entity_id").toString();
+    QHash<QString, QVariantMap>::const_iterator registered = m_registered.constFind(device);
+    if (registered != m_registered.constEnd()) {
+        if (registered.value() == catalogEntity) {
+            return;
+        }
+        // changed type, name or features: created again
+        m_api->removeEntity(entityId(device));
+    }
+    m_registered.insert(device, catalogEntity);
+
+    // the catalog keeps the Homey deviceIds, the entities get the namespaced IDs
+    QVariantMap entity = catalogEntity;
+    if (!m_entityPrefix.isEmpty()) {
+        entity.insert("entity_id", entityId(entity.value("entity_id").toString()));
+    }
+
+    // add entity to allAvailableEntities list
+    if (!addAvailableEntity(entity.value("entity_id").toString(), entity.value("type").toString(),
+                            entity.value("integration").toString(), entity.value("friendly_name").toString(),
+                            entity.value("supported_features").toStringList())) {
+        m_unavailableEntities.append(entity.value("entity_id").toString());
+    }
+
+    // create an entity
+    if (!m_api->addEntity(entity)) {
+        m_duplicateEntities.append(entity.value("entity_id").toString());
+    }
+}
+
+void Homey::restoreSnapshot() {
+    m_snapshotRestored = true;
+
+    QHash<QString, HomeyStateUpdate> states;
+    if (!m_snapshot.load(&m_catalog, &states)) {
+        qCDebug(m_logCategory) << "No valid entity snapshot found:" << m_snapshot.fileName();
+        return;
+    }
+
+    qCInfo(m_logCategory) << "Restoring" << m_catalog.size() << "entities and" << states.size()
+                          << "states from snapshot";
+
+    // The last known catalog and states are shown until the Homey app sends live data. The states are applied once
+    // the entities are registered.
+    for (const HomeyStateUpdate &state : states) {
+        bufferUpdate(state);
+    }
+    startEntityRegistration();
+}
+
+void Homey::scheduleSnapshot() {
+    m_snapshotDirty = true;
+    if (!m_snapshotTimer->isActive()) {
+        m_snapshotTimer->start();
+    }
+}
+
+void Homey::saveSnapshot() {
+    m_snapshotTimer->stop();
+    if (!m_snapshotDirty) {
+        return;
+    }
+
+    if (m_snapshot.save(m_catalog, m_lastStates)) {
+        m_snapshotDirty = false;
+    } else {
+        qCWarning(m_logCategory) << "Failed to write entity snapshot:" << m_snapshot.fileName();
     }
 }
 
 void Homey::onStateChanged(QAbstractSocket::SocketState state) {
     if (state == QAbstractSocket::UnconnectedState && !m_userDisconnect) {
         qCDebug(m_logCategory) << "State changed to 'Unconnected': starting reconnect";
-        if (m_webSocket->isValid()) {
-            m_webSocket->close();
-        }
-        setState(DISCONNECTED);
-        m_wsReconnectTimer->start();
+        scheduleReconnect();
     }
 }
 
 void Homey::onError(QAbstractSocket::SocketError error) {
     qCWarning(m_logCategory) << error << m_webSocket->errorString();
-    if (m_webSocket->isValid()) {
-        m_webSocket->close();
+    if (!m_userDisconnect) {
+        scheduleReconnect();
+    }
+}
+
+void Homey::onLinkDead() {
+    qCWarning(m_logCategory) << "No answer from Homey within" << PING_TIMEOUT << "ms: reconnecting";
+    scheduleReconnect();
+}
+
+void Homey::scheduleReconnect() {
+    // error and state change signals of the same failure
+    if (m_wsReconnectTimer->isActive()) {
+        return;
+    }
+
+    // started first: aborting the socket emits the state change again
+    m_wsReconnectTimer->start(m_backoff.next());
+
+    m_linkMonitor->stop();
+    if (m_webSocket->state() != QAbstractSocket::UnconnectedState) {
+        m_webSocket->abort();
     }
+
+    // pending slider values are stale, results of sent commands won't arrive anymore
+    m_commandQueue->clear();
+    m_requests->clear();
+    m_outbox->clear();
+
     setState(DISCONNECTED);
-    m_wsReconnectTimer->start();
+    if (!m_disconnectedSince.isValid()) {
+        m_disconnectedSince.start();
+    }
+
+    // the cached address might be outdated
+    lookupHost();
+    if (m_discovery) {
+        m_discovery->query();
+    }
 }
 
 void Homey::onTimeout() {
-    if (m_tries == 3) {
-        m_wsReconnectTimer->stop();
-
-        qCCritical(m_logCategory) << "Cannot connect to Homey: retried 3 times connecting to" << m_ip;
+    if (m_backoff.attempts() > RECONNECT_NOTIFY_ATTEMPTS && !m_reconnectNotified) {
+        m_reconnectNotified = true;
+        qCCritical(m_logCategory) << "Cannot connect to Homey: retried" << RECONNECT_NOTIFY_ATTEMPTS
+                                  << "times connecting to" << m_ip << ", retrying in the background";
 
         QObject *param = this;
         m_notifications->add(
-            true, tr("Cannot connect to Homey."), tr("Reconnect"),
+            true, m_hubId.isEmpty() ? tr("Cannot connect to Homey.") : tr("Cannot connect to Homey %1.").arg(m_hubId),
+            tr("Reconnect"),
             [](QObject *param) {
                 Integration *i = qobject_cast<Integration *>(param);
                 i->connect();
             },
             param);
+    }
 
-        disconnect();
-        m_tries = 0;
-    } else {
-        // FIXME magic number
-        m_webSocketId = 4;
-        if (m_state != CONNECTING) {
-            setState(CONNECTING);
-        }
+    if (m_state != CONNECTING) {
+        setState(CONNECTING);
+    }
 
-        qCDebug(m_logCategory) << "Reconnection attempt" << m_tries + 1 << "to Homey server:" << m_url;
-        disconnect();
-        m_webSocket->open(QUrl(m_url));
+    qCDebug(m_logCategory) << "Reconnection attempt" << m_backoff.attempts() << "to Homey server:" << m_url;
+    m_metrics.reconnectAttempts++;
+    openSocket();
+}
 
-        m_tries++;
+void Homey::openSocket() {
+    QUrl url(m_url);
+    if (!m_address.isNull()) {
+        url.setHost(m_address.toString());
+    }
+    if (m_endpointPort > 0) {
+        url.setPort(m_endpointPort);
     }
+    m_webSocket->open(url);
 }
 
-void Homey::webSocketSendCommand(const QVariantMap &data) {
-    QJsonDocument doc = QJsonDocument::fromVariant(data);
-    QString       message = doc.toJson(QJsonDocument::JsonFormat::Compact);
-    if (m_webSocket->isValid()) {
-        m_webSocket->sendTextMessage(message);
+void Homey::lookupHost() {
+    // nothing to resolve for an IP address, one lookup at a time
+    if (m_hostLookupId >= 0 || !QHostAddress(m_ip).isNull()) {
+        return;
     }
+    m_hostLookupId = QHostInfo::lookupHost(m_ip, this, &Homey::onHostLookup);
 }
 
-int Homey::convertBrightnessToPercentage(float value) {
-    return static_cast<int>(round(value * 100));
+void Homey::onEndpointFound(const QString &host, const QHostAddress &address, quint16 port) {
+    // the configured Homey by name or address, or the first one found without configuration
+    bool configured = m_ip.isEmpty() || host.compare(m_ip, Qt::CaseInsensitive) == 0 || QHostAddress(m_ip) == address ||
+                      (!m_address.isNull() && address == m_address);
+    if (!configured) {
+        qCDebug(m_logCategory) << "Ignoring Homey" << host << "found with mDNS";
+        return;
+    }
+    if (address == m_address && port == m_endpointPort) {
+        return;
+    }
+
+    qCInfo(m_logCategory) << "Found Homey" << host << "at" << address.toString() << port;
+    m_address = address;
+    m_endpointPort = port;
+
+    QSettings endpoint(m_endpointFile, QSettings::IniFormat);
+    endpoint.setValue("host", host);
+    endpoint.setValue("address", address.toString());
+    endpoint.setValue("port", port);
+
+    // don't wait for the backoff delay with a new endpoint
+    if (m_wsReconnectTimer->isActive()) {
+        m_wsReconnectTimer->start(0);
+    }
 }
 
-void Homey::updateEntity(const QString &entity_id, const QVariantMap &attr) {
-    EntityInterface *entity = m_entities->getEntityInterface(entity_id);
-    if (entity) {
-        if (entity->type() == "light") {
-            updateLight(entity, attr);
-        }
-        if (entity->type() == "blind") {
-            updateBlind(entity, attr);
-        }
-        if (entity->type() == "media_player") {
-            updateMediaPlayer(entity, attr);
+void Homey::onHostLookup(const QHostInfo &info) {
+    m_hostLookupId = -1;
+    if (info.error() != QHostInfo::NoError || info.addresses().isEmpty()) {
+        // keep the last known address, e.g. while roaming without DNS
+        qCDebug(m_logCategory) << "Failed to resolve" << m_ip << ":" << info.errorString();
+        return;
+    }
+
+    // prefer IPv4: the Homey app listens on IPv4
+    QHostAddress address = info.addresses().first();
+    for (const QHostAddress &candidate : info.addresses()) {
+        if (candidate.protocol() == QAbstractSocket::IPv4Protocol) {
+            address = candidate;
+            break;
         }
-        if (entity->type() == "climate") {
-            updateClimate(entity, attr);
+    }
+
+    if (address != m_address) {
+        qCDebug(m_logCategory) << "Resolved" << m_ip << "to" << address.toString();
+        m_address = address;
+    }
+}
+
+void Homey::webSocketSendCommand(const QString &deviceId, const QByteArray &capability, const QByteArray &message) {
+    if (!m_webSocket->isValid()) {
+        return;
+    }
+
+    // add the request id for correlating the result: {..., "id":<id>}
+    int        id = m_requests->nextId();
+    QByteArray request = message;
+    request.insert(request.size() - 1, ",\"id\":" + QByteArray::number(id));
+
+    // Only retry commands which set an absolute value: a repeated toggle or next track would be executed twice if
+    // just the result got lost. Without command results from the Homey app the event is the only acknowledgement,
+    // which doesn't come if the value didn't change: no retries in that case either.
+    bool retry = (m_serverFeatures & FEATURE_COMMAND_RESULT) && capability != "toggle" &&
+                 capability != "speaker_next" && capability != "speaker_prev";
+    m_requests->add(id, deviceId, request, retry);
+
+    m_outbox->send(request, HomeyOutbox::INTERACTIVE);
+}
+
+void Homey::onRequestResend(int id, const QByteArray &message) {
+    qCDebug(m_logCategory) << "No result for command" << id << ": sending it again";
+    m_outbox->send(message, HomeyOutbox::INTERACTIVE);
+}
+
+void Homey::onRequestLost(const QString &deviceId) {
+    if (!(m_serverFeatures & FEATURE_COMMAND_RESULT)) {
+        // an unchanged value doesn't create an event, the command might have been executed
+        qCDebug(m_logCategory) << "Command for" << deviceId << "not confirmed by Homey";
+        return;
+    }
+
+    qCWarning(m_logCategory) << "Command for" << deviceId << "lost, statistics:" << m_requests->statistics();
+    EntityInterface *entity = m_entities->getEntityInterface(entityId(deviceId));
+    m_notifications->add(true, tr("Homey did not respond to a command for %1.")
+                                   .arg(entity ? entity->friendly_name() : deviceId));
+}
+
+QVariantMap Homey::commandStatistics() const {
+    return m_requests->statistics();
+}
+
+QVariantMap Homey::metrics() const {
+    // same order as the MessageType and HomeyEntityKind enums
+    static const char *messageTypes[] = {"unknown", "event", "sendStates", "sendStatesBatch", "result", "connected",
+                                         "command", "sendEntities"};
+    static const char *entityKinds[] = {"unknown", "light", "blind", "media_player", "climate", "switch"};
+    static_assert(sizeof(messageTypes) / sizeof(messageTypes[0]) == MSG_COUNT, "a message type name is missing");
+    static_assert(sizeof(entityKinds) / sizeof(entityKinds[0]) == KIND_COUNT, "an entity kind name is missing");
+    static_assert(HomeyMetrics::MESSAGE_TYPES == MSG_COUNT, "HomeyMetrics::MESSAGE_TYPES out of date");
+
+    QVariantMap messages;
+    for (int i = 0; i < MSG_COUNT; i++) {
+        messages.insert(messageTypes[i], m_metrics.messages[i]);
+    }
+
+    QVariantMap updateTimes;
+    for (int i = KIND_LIGHT; i < KIND_COUNT; i++) {
+        updateTimes.insert(entityKinds[i], m_metrics.updateTime[i].toVariant());
+    }
+
+    QVariantMap map;
+    if (!m_hubId.isEmpty()) {
+        map.insert("hub", m_hubId);
+    }
+    map.insert("messages", messages);
+    map.insert("bytes_in", m_metrics.bytesIn);
+    map.insert("bytes_out", m_outbox->bytesSent());
+    map.insert("parse_time_us", m_metrics.parseTime.toVariant());
+    map.insert("update_time_us", updateTimes);
+    map.insert("updates_applied", m_metrics.updatesApplied);
+    map.insert("updates_skipped", m_metrics.updatesSkipped);
+    map.insert("attributes_skipped", m_metrics.attributesSkipped);
+    map.insert("entity_batches", m_metrics.entityBatches);
+    map.insert("entity_mutations", m_metrics.entityMutations);
+    map.insert("reconnect_attempts", m_metrics.reconnectAttempts);
+    map.insert("reconnect_time_ms", m_metrics.reconnectTime.toVariant());
+    map.insert("ping_rtt_ms", m_metrics.pingTime.toVariant());
+    map.insert("command_queue", m_commandQueue->pending());
+    map.insert("outbox", m_outbox->statistics());
+    if (m_albumArt) {
+        map.insert("album_art_images", m_albumArt->count());
+        map.insert("album_art_bytes", m_albumArt->bytes());
+    }
+    map.insert("commands", m_requests->statistics());
+    return map;
+}
+
+void Homey::onMetricsTimeout() {
+    QVariantMap report = metrics();
+    qCInfo(m_logCategory).noquote() << "Metrics:"
+                                    << QJsonDocument::fromVariant(report).toJson(QJsonDocument::JsonFormat::Compact);
+    emit metricsReport(report);
+}
+
+QString Homey::eventDeviceId(const QByteArray &frame) {
+    // {"type":"event","data":{"entity_id":"<deviceId>",...}} as sent by the Homey app, without whitespace
+    static const QByteArray EVENT_TYPE("\"type\":\"event\"");
+    static const QByteArray ENTITY_ID("\"entity_id\":\"");
+
+    if (!frame.contains(EVENT_TYPE)) {
+        return QString();
+    }
+    int start = frame.indexOf(ENTITY_ID);
+    if (start < 0) {
+        return QString();
+    }
+    start += ENTITY_ID.size();
+    int end = frame.indexOf('"', start);
+    int escape = frame.indexOf('\\', start);
+    if (end < 0 || (escape >= 0 && escape < end)) {
+        return QString();
+    }
+    return QString::fromUtf8(frame.constData() + start, end - start);
+}
+
+bool Homey::deferEvent(const QByteArray &frame) {
+    // unexpected frames are decoded right away
+    QString deviceId = eventDeviceId(frame);
+    if (deviceId.isEmpty()) {
+        return false;
+    }
+    m_metrics.messages[MSG_EVENT]++;
+
+    QVector<QByteArray> &frames = m_standbyFrames[deviceId];
+    if (frames.size() >= STANDBY_FRAMES_PER_DEVICE) {
+        // bounded memory for chatty devices: fold the older frames into the pending update
+        for (const QByteArray &older : frames) {
+            bufferEvent(older);
         }
-        if (entity->type() == "switch") {
-            updateSwitch(entity, attr);
+        frames.clear();
+    }
+    frames.append(frame);
+    return true;
+}
+
+void Homey::decodeDeferredEvents() {
+    QHash<QString, QVector<QByteArray>> frames;
+    frames.swap(m_standbyFrames);
+    for (const QVector<QByteArray> &deviceFrames : frames) {
+        for (const QByteArray &frame : deviceFrames) {
+            bufferEvent(frame);
         }
     }
 }
 
-void Homey::updateLight(EntityInterface *entity, const QVariantMap &attr) {
-    // onoff to state.
-    if (attr.contains("onoff")) {
-        entity->setState(attr.value("onoff").toBool() ? LightDef::ON : LightDef::OFF);
+void Homey::bufferEvent(const QByteArray &frame) {
+    QJsonObject root = QJsonDocument::fromJson(frame).object();
+    bufferUpdate(HomeyStateUpdate::fromJson(root.value(QLatin1String("data")).toObject()));
+}
+
+void Homey::queueUpdate(const HomeyStateUpdate &update) {
+    // during registration the entity might not exist yet: buffered until registration is finished
+    if (m_updateTimer->interval() <= 0 && !m_standby && !isRegisteringEntities()) {
+        updateEntity(update);
+        applyEntityMutations();
+        return;
     }
 
-    // brightness
-    if (entity->isSupported(LightDef::F_BRIGHTNESS)) {
-        if (attr.contains("dim")) {
-            entity->updateAttrByIndex(LightDef::BRIGHTNESS, convertBrightnessToPercentage(attr.value("dim").toFloat()));
-        }
+    // bursts for the same entity are merged: the entity model only sees the latest value per tick
+    bufferUpdate(update);
+
+    if (!m_updateTimer->isActive()) {
+        m_updateTimer->start();
     }
+}
 
-    // color
-    if (entity->isSupported(LightDef::F_COLOR)) {
-        QVariant     color = attr.value("attributes").toMap().value("rgb_color");
-        QVariantList cl(color.toList());
-        char         buffer[10];
-        snprintf(buffer, sizeof(buffer), "#%02X%02X%02X", cl.value(0).toInt(), cl.value(1).toInt(),
-                 cl.value(2).toInt());
-        entity->updateAttrByIndex(LightDef::COLOR, buffer);
+void Homey::queueUpdates(const QJsonArray &states) {
+    for (const QJsonValue &state : states) {
+        bufferUpdate(HomeyStateUpdate::fromJson(state.toObject()));
     }
+
+    // a batch is applied in one pass together with everything already pending, no need to wait for the next tick
+    m_updateTimer->stop();
+    onUpdateTimeout();
 }
 
-void Homey::updateBlind(EntityInterface *entity, const QVariantMap &attr) {
-    Q_UNUSED(entity);
-    Q_UNUSED(attr);
-    //    QVariantMap attributes;
+void Homey::bufferUpdate(const HomeyStateUpdate &update) {
+    QHash<QString, HomeyStateUpdate>::iterator it = m_pendingUpdates.find(update.entityId);
+    if (it == m_pendingUpdates.end()) {
+        m_pendingUpdates.insert(update.entityId, update);
+    } else {
+        it.value().merge(update);
+    }
+}
 
-    //    // state
-    //    if (attr.value("state").toString() == "open") {
-    //        attributes.insert("state", true);
-    //    } else {
-    //        attributes.insert("state", false);
-    //    }
+void Homey::onUpdateTimeout() {
+    if (isRegisteringEntities() || m_standby) {
+        // applied when the entity registration is finished or when leaving standby
+        return;
+    }
 
-    //    // position
-    //    if (entity->supported_features().indexOf("POSITION") > -1) {
-    //        attributes.insert("position", attr.value("attributes").toMap().value("current_position").toInt());
-    //    }
+    QHash<QString, HomeyStateUpdate> updates;
+    updates.swap(m_pendingUpdates);
 
-    //    m_entities->update(entity->entity_id(), attributes);
+    for (QHash<QString, HomeyStateUpdate>::const_iterator it = updates.constBegin(); it != updates.constEnd(); ++it) {
+        updateEntity(it.value());
+    }
+    applyEntityMutations();
 }
 
-void Homey::updateMediaPlayer(EntityInterface *entity, const QVariantMap &attr) {
-    /*  capabilities:
-       [ 'speaker_album',
-         'speaker_artist',
-         'speaker_duration',
-         'speaker_next',
-         'speaker_playing',
-         'speaker_position',
-         'speaker_prev',
-         'speaker_repeat',
-         'volume_set',
-         'volume_mute',
-         'speaker_shuffle',
-         'speaker_track',
-         'sonos_group',
-         'sonos_audio_clip' ]
-    */
-    // QVariantMap attributes;
+Homey::EntityHandle Homey::resolveEntity(const QString &deviceId, EntityInterface *entity) {
+    EntityHandle handle;
+    if (!entity) {
+        return handle;
+    }
+
+    handle.entity = entity;
+    handle.object = dynamic_cast<QObject *>(entity);
+    handle.kind = HomeyCapabilityMap::entityKind(entity->type());
 
-    // state
-    if (attr.contains("speaker_playing")) {
-        if (attr.value("speaker_playing").toBool()) {
-            entity->setState(MediaPlayerDef::PLAYING);
-        } else {
-            entity->setState(MediaPlayerDef::IDLE);
+    // features the capability mappings of the entity type depend on
+    for (int bit = 0; bit < HomeyStateUpdate::CAPABILITY_COUNT; bit++) {
+        const HomeyCapabilityMap::Attribute *mapping = HomeyCapabilityMap::attribute(handle.kind, bit);
+        if (mapping && mapping->feature >= 0 && entity->isSupported(mapping->feature)) {
+            handle.features |= Q_UINT64_C(1) << mapping->feature;
         }
     }
 
-    if (attr.contains("onoff")) {
-        if (attr.value("onoff").toBool()) {
-            entity->setState(MediaPlayerDef::ON);
-        } else {
-            entity->setState(MediaPlayerDef::OFF);
+    // the entities don't notify the integration when they are removed
+    if (handle.object) {
+        m_entityObjects.insert(handle.object, deviceId);
+        QObject::connect(handle.object, &QObject::destroyed, this, &Homey::onEntityDestroyed, Qt::UniqueConnection);
+    }
+
+    return handle;
+}
+
+void Homey::rebuildEntityHandles(const QList<EntityInterface *> &entities) {
+    QHash<QString, EntityHandle> previous;
+    previous.swap(m_entityHandles);
+
+    // devices without an entity so far might have one now
+    m_unknownDevices.clear();
+
+    m_entityHandles.reserve(entities.size());
+    for (EntityInterface *entity : entities) {
+        const QString id = deviceId(entity->entity_id());
+        EntityHandle  handle = resolveEntity(id, entity);
+
+        // keep the values last pushed to an unchanged entity
+        QHash<QString, EntityHandle>::const_iterator old = previous.constFind(id);
+        if (old != previous.constEnd() && old.value().entity == entity) {
+            handle.state = old.value().state;
+            handle.attributes = old.value().attributes;
         }
+
+        m_entityHandles.insert(id, handle);
     }
+}
+
+void Homey::onEntityDestroyed(QObject *object) {
+    QHash<QObject *, QString>::iterator watched = m_entityObjects.find(object);
+    if (watched == m_entityObjects.end()) {
+        return;
+    }
+
+    // Queued from the entities' thread: the address might already belong to a new entity of the same device, which
+    // is watched again. The handle of a reloaded entity with a new address is kept too.
+    QHash<QString, EntityHandle>::iterator handle = m_entityHandles.find(watched.value());
+    if (handle != m_entityHandles.end() && handle.value().object == object) {
+        return;
+    }
+    m_entityObjects.erase(watched);
+
+    if (handle != m_entityHandles.end() && handle.value().object.isNull()) {
+        qCDebug(m_logCategory) << "Entity of" << handle.key() << "removed";
+        m_albumArtPending.remove(handle.key());
+        m_revisions.remove(handle.key());
+        removeEntityId(handle.key());
+        m_entityHandles.erase(handle);
+        sendSubscription();
+    }
+}
 
-    // FIXME
-    // source
-    // if (entity->supported_features().indexOf("SOURCE") > -1 && attr.value("attributes").toMap().contains("source")) {
-    //    attributes.insert("source", attr.value("attributes").toMap().value("source").toString());
-    //}
+void Homey::setEntityState(EntityHandle &handle, int state) {
+    if (handle.state == state) {
+        m_metrics.attributesSkipped++;
+        return;
+    }
+    handle.state = state;
+    m_mutations.append(EntityMutation{handle.entity, handle.object, HomeyCapabilityMap::STATE, state});
+}
 
-    // volume  //volume_set
-    if (attr.contains("volume_set")) {
-        entity->updateAttrByIndex(MediaPlayerDef::VOLUME,
-                                  static_cast<int>(round(attr.value("volume_set").toDouble() * 100)));
+void Homey::setEntityAttribute(EntityHandle &handle, int attribute, const QVariant &value) {
+    if (attribute < handle.attributes.size()) {
+        if (handle.attributes.at(attribute) == value) {
+            m_metrics.attributesSkipped++;
+            return;
+        }
+    } else {
+        handle.attributes.resize(attribute + 1);
     }
+    handle.attributes[attribute] = value;
+    m_mutations.append(EntityMutation{handle.entity, handle.object, attribute, value});
+}
 
-    // media type
-    if (entity->isSupported(MediaPlayerDef::F_MEDIA_TYPE) &&
-        attr.value("attributes").toMap().contains("media_content_type")) {
-        entity->updateAttrByIndex(MediaPlayerDef::MEDIATYPE,
-                                  attr.value("attributes").toMap().value("media_content_type").toString());
+void Homey::applyEntityMutations() {
+    if (m_mutations.isEmpty()) {
+        return;
     }
 
-    // media image
-    if (attr.contains("album_art")) {
-        entity->updateAttrByIndex(MediaPlayerDef::MEDIAIMAGE, attr.value("album_art"));
+    QVector<EntityMutation> mutations;
+    mutations.swap(m_mutations);
+    m_metrics.entityBatches++;
+    m_metrics.entityMutations += static_cast<quint64>(mutations.size());
+
+    auto apply = [mutations]() {
+        for (const EntityMutation &mutation : mutations) {
+            if (mutation.object.isNull()) {
+                continue;
+            }
+            if (mutation.attribute == HomeyCapabilityMap::STATE) {
+                mutation.entity->setState(mutation.value.toInt());
+            } else {
+                mutation.entity->updateAttrByIndex(mutation.attribute, mutation.value);
+            }
+        }
+    };
+
+    // The entities live in the application thread: one queued call per processing pass instead of a queued signal
+    // per changed attribute. All changes of the pass are applied in the same event loop iteration.
+    if (QThread::currentThread() == qApp->thread()) {
+        apply();
+    } else {
+        QMetaObject::invokeMethod(qApp, apply, Qt::QueuedConnection);
     }
+}
+
+bool Homey::isRemoteImage(const QString &url) {
+    return url.startsWith(QLatin1String("http://")) || url.startsWith(QLatin1String("https://"));
+}
 
-    // media title
-    if (attr.contains("speaker_track")) {
-        entity->updateAttrByIndex(MediaPlayerDef::MEDIATITLE, attr.value("speaker_track").toString());
+QVariant Homey::albumArt(const QString &entityId, const QString &url) {
+    if (!m_albumArt || !isRemoteImage(url)) {
+        m_albumArtPending.remove(entityId);
+        return url;
     }
 
-    // media artist
-    if (attr.contains("speaker_artist")) {
-        entity->updateAttrByIndex(MediaPlayerDef::MEDIAARTIST, attr.value("speaker_artist").toString());
+    QString image = m_albumArt->image(url);
+    if (image.isEmpty()) {
+        // set by onAlbumArtReady, the entity keeps the previous image until then
+        m_albumArtPending.insert(entityId, url);
+        return QVariant();
     }
+    m_albumArtPending.remove(entityId);
+    return image;
 }
 
-void Homey::updateClimate(EntityInterface *entity, const QVariantMap &attr) {
-    // FIXME
-    Q_UNUSED(entity);
-    Q_UNUSED(attr);
+void Homey::onAlbumArtReady(const QString &url, const QString &localUrl) {
+    if (localUrl == url) {
+        qCDebug(m_logCategory) << "Failed to cache album art, using the remote image:" << url;
+    }
+
+    // every media player waiting for the image, e.g. all members of a Sonos group
+    for (QHash<QString, QString>::iterator it = m_albumArtPending.begin(); it != m_albumArtPending.end();) {
+        if (it.value() != url) {
+            ++it;
+            continue;
+        }
+
+        QHash<QString, EntityHandle>::iterator handle = m_entityHandles.find(it.key());
+        if (handle != m_entityHandles.end() && handle.value().entity) {
+            setEntityAttribute(handle.value(), MediaPlayerDef::MEDIAIMAGE, localUrl);
+        }
+        it = m_albumArtPending.erase(it);
+    }
+    applyEntityMutations();
 }
 
-void Homey::updateSwitch(EntityInterface *entity, const QVariantMap &attr) {
-    // onoff to state.
-    if (attr.contains("onoff")) {
-        entity->setState(attr.value("onoff").toBool() ? SwitchDef::ON : SwitchDef::OFF);
+void Homey::updateEntity(const HomeyStateUpdate &update) {
+    QHash<QString, EntityHandle>::iterator it = m_entityHandles.find(update.entityId);
+    if (it == m_entityHandles.end()) {
+        // devices without a loaded entity aren't looked up for every event, but the entity might be loaded later
+        QHash<QString, qint64>::const_iterator unknown = m_unknownDevices.constFind(update.entityId);
+        if (unknown != m_unknownDevices.constEnd() && m_clock.elapsed() - unknown.value() < UNKNOWN_DEVICE_RETRY) {
+            m_metrics.updatesSkipped++;
+            return;
+        }
+
+        EntityInterface *entity = m_entities->getEntityInterface(entityId(update.entityId));
+        if (!entity) {
+            m_unknownDevices.insert(update.entityId, m_clock.elapsed());
+            m_metrics.updatesSkipped++;
+            return;
+        }
+        m_unknownDevices.remove(update.entityId);
+        it = m_entityHandles.insert(update.entityId, resolveEntity(update.entityId, entity));
+    }
+
+    EntityHandle &handle = it.value();
+    if (handle.kind == KIND_UNKNOWN) {
+        m_metrics.updatesSkipped++;
+        return;
     }
+    m_metrics.updatesApplied++;
+
+    QElapsedTimer updateTimer;
+    updateTimer.start();
+
+    if (handle.entity) {
+        // remember the last known state for the startup snapshot
+        QHash<QString, HomeyStateUpdate>::iterator last = m_lastStates.find(update.entityId);
+        if (last == m_lastStates.end()) {
+            m_lastStates.insert(update.entityId, update);
+        } else {
+            last.value().merge(update);
+        }
+        scheduleSnapshot();
+    }
+
+    // highest capability first: onoff is applied after speaker_playing and decides the media player state
+    for (int bit = HomeyStateUpdate::CAPABILITY_COUNT - 1; bit >= 0; bit--) {
+        if ((update.present & (1u << bit)) == 0) {
+            continue;
+        }
+
+        const HomeyCapabilityMap::Attribute *mapping = HomeyCapabilityMap::attribute(handle.kind, bit);
+        if (!mapping || (mapping->feature >= 0 && !handle.isSupported(mapping->feature))) {
+            continue;
+        }
+
+        if (mapping->transform == HomeyCapabilityMap::T_PREFETCH) {
+            if (m_albumArt && isRemoteImage(update.text(mapping->capability))) {
+                m_albumArt->prefetch(update.text(mapping->capability));
+            }
+        } else if (mapping->transform == HomeyCapabilityMap::T_IMAGE) {
+            QVariant image = albumArt(update.entityId, update.text(mapping->capability));
+            if (image.isValid()) {
+                setEntityAttribute(handle, mapping->attribute, image);
+            }
+        } else if (mapping->attribute == HomeyCapabilityMap::STATE) {
+            setEntityState(handle, HomeyCapabilityMap::state(*mapping, update));
+        } else {
+            setEntityAttribute(handle, mapping->attribute, HomeyCapabilityMap::value(*mapping, update));
+        }
+    }
+
+    // Only revisions of states shown by an entity: with the revision of a device without entity, delta sync would
+    // skip its state once the entity is loaded.
+    if (update.revision >= 0) {
+        m_revisions.insert(update.entityId, update.revision);
+    }
+
+    m_metrics.updateTime[handle.kind].add(updateTimer.nsecsElapsed() / 1000);
 }
 
 void Homey::connect() {
     m_userDisconnect = false;
+    m_serverFeatures = 0;
+
+    // populate entities from the last session, before the socket is even connected
+    if (!m_snapshotRestored) {
+        restoreSnapshot();
+    }
 
     setState(CONNECTING);
 
     // reset the reconnnect trial variable
-    m_tries = 0;
+    m_backoff.reset();
+    m_reconnectNotified = false;
+    m_wsReconnectTimer->stop();
 
-    // turn on the websocket connection
+    // turn on the websocket connection, with the cached address if already resolved
     qCDebug(m_logCategory) << "Connecting to Homey server:" << m_url;
-    m_webSocket->open(QUrl(m_url));
+    openSocket();
+    lookupHost();
+    if (m_discovery && !m_discovery->start()) {
+        qCWarning(m_logCategory) << "Failed to start the mDNS service discovery";
+    }
 }
 
 void Homey::disconnect() {
@@ -402,6 +1296,17 @@ void Homey::disconnect() {
 
     // turn of the reconnect try
     m_wsReconnectTimer->stop();
+    m_linkMonitor->stop();
+    if (m_discovery) {
+        m_discovery->stop();
+    }
+
+    // pending slider values are stale once disconnected, results of sent commands won't arrive anymore
+    m_commandQueue->clear();
+    m_requests->clear();
+    m_outbox->clear();
+
+    saveSnapshot();
 
     // turn off the socket
     m_webSocket->close();
@@ -409,99 +1314,103 @@ void Homey::disconnect() {
     setState(DISCONNECTED);
 }
 
+void Homey::enterStandby() {
+    if (m_standby) {
+        return;
+    }
+    m_standby = true;
+    m_updateTimer->stop();
+
+    // no wakeups for pings, the link is checked when leaving standby
+    m_linkMonitor->stop();
+
+    sendStandby();
+    qCDebug(m_logCategory) << "Entering standby";
+}
+
+void Homey::sendStandby() {
+    // a Homey app supporting it stops sending events altogether
+    if (m_serverFeatures & FEATURE_STANDBY) {
+        m_outbox->send("{\"type\":\"standby\"}", HomeyOutbox::INTERACTIVE);
+    }
+}
+
+void Homey::leaveStandby() {
+    if (!m_standby) {
+        return;
+    }
+    m_standby = false;
+
+    // the link might have died during standby
+    if (m_webSocket->isValid()) {
+        m_linkMonitor->start();
+        m_linkMonitor->ping();
+    }
+
+    // applied first: the resume message carries their revisions
+    qCDebug(m_logCategory) << "Leaving standby, applying the events of" << m_standbyFrames.size() << "devices";
+    decodeDeferredEvents();
+
+    // one consolidated update of all entities changed while in standby
+    m_updateTimer->stop();
+    onUpdateTimeout();
+
+    if (m_serverFeatures & FEATURE_STANDBY) {
+        // {"type":"resume","revisions":{"<deviceId>":<revision>,...}}: the Homey app answers with the states changed
+        // since the given revisions, or all states without revisions
+        QJsonObject resume;
+        resume.insert(QLatin1String("type"), QLatin1String("resume"));
+        if (m_serverFeatures & FEATURE_DELTA_SYNC) {
+            QJsonObject revisions;
+            for (QHash<QString, qint64>::const_iterator it = m_revisions.constBegin(); it != m_revisions.constEnd();
+                 ++it) {
+                revisions.insert(it.key(), static_cast<double>(it.value()));
+            }
+            resume.insert(QLatin1String("revisions"), revisions);
+        }
+        m_outbox->send(QJsonDocument(resume).toJson(QJsonDocument::JsonFormat::Compact), HomeyOutbox::INTERACTIVE);
+    }
+}
+
 void Homey::sendCommand(const QString &type, const QString &entityId, int command, const QVariant &param) {
     // example
-    // {"command":"onoff","deviceId":"78f3ab16-c622-4bd7-aebf-3ca981e41375","type":"command","value":true}
+    // {"type":"command","command":"onoff","value":true,"deviceId":"78f3ab16-c622-4bd7-aebf-3ca981e41375"}
+
+    const QString                          device = deviceId(entityId);
+    QHash<QString, EntityHandle>::iterator handle = m_entityHandles.find(device);
+    HomeyEntityKind                        kind = KIND_UNKNOWN;
+    if (handle != m_entityHandles.end() && handle.value().entity) {
+        // resolved with the first state of the entity
+        kind = handle.value().kind;
+    } else {
+        kind = HomeyCapabilityMap::entityKind(type);
+    }
 
-    // TODO(zehnm) enhance webSocketSendCommand with command / value arguments to reduce QVariantMap overhead
-    QVariantMap map;
-    map.insert("type", "command");
-    map.insert("deviceId", QVariant(entityId));
-
-    if (type == "light") {
-        if (command == LightDef::C_TOGGLE) {
-            map.insert("command", QVariant("toggle"));
-            map.insert("value", true);
-            webSocketSendCommand(map);
-        } else if (command == LightDef::C_ON) {
-            map.insert("command", QVariant("onoff"));
-            map.insert("value", true);
-            webSocketSendCommand(map);
-        } else if (command == LightDef::C_OFF) {
-            map.insert("command", QVariant("onoff"));
-            map.insert("value", false);
-            webSocketSendCommand(map);
-        } else if (command == LightDef::C_BRIGHTNESS) {
-            map.insert("command", "dim");
-            float value = param.toFloat() / 100;
-            map.insert("value", value);
-            webSocketSendCommand(map);
-        } else if (command == LightDef::C_COLOR) {
-            QColor color = param.value<QColor>();
-            // QVariantMap data;
-            QVariantList list;
-            list.append(color.red());
-            list.append(color.green());
-            list.append(color.blue());
-            map.insert("command", "color");
-            map.insert("value", list);
-            webSocketSendCommand(map);
-            // webSocketSendCommand(type, "turn_on", entity_id, &data);
-        }
-    } else if (type == "blind") {
-        if (command == BlindDef::C_OPEN) {
-            map.insert("command", "windowcoverings_closed");
-            map.insert("value", "false");
-            webSocketSendCommand(map);
-        } else if (command == BlindDef::C_CLOSE) {
-            map.insert("command", "windowcoverings_closed");
-            map.insert("value", "true");
-            webSocketSendCommand(map);
-        } else if (command == BlindDef::C_STOP) {
-            map.insert("command", "windowcoverings_tilt_set");
-            map.insert("value", 0);
-            webSocketSendCommand(map);
-        } else if (command == BlindDef::C_POSITION) {
-            map.insert("command", "windowcoverings_set");
-            map.insert("value", param);
-            webSocketSendCommand(map);
-        }
-    } else if (type == "media_player") {
-        if (command == MediaPlayerDef::C_VOLUME_SET) {
-            map.insert("command", "volume_set");
-            map.insert("value", param.toDouble() / 100);
-            QVariantMap attributes;
-            attributes.insert("volume", param);
-            m_entities->update(entityId, attributes);  // buggy homey fix
-            webSocketSendCommand(map);
-        } else if (command == MediaPlayerDef::C_PLAY) {
-            map.insert("command", "speaker_playing");
-            map.insert("value", true);
-            webSocketSendCommand(map);
-        } else if (command == MediaPlayerDef::C_STOP) {
-            map.insert("command", "speaker_playing");
-            map.insert("value", false);
-            webSocketSendCommand(map);
-        } else if (command == MediaPlayerDef::C_PAUSE) {
-            map.insert("command", "speaker_playing");
-            map.insert("value", false);
-            webSocketSendCommand(map);
-        } else if (command == MediaPlayerDef::C_PREVIOUS) {
-            map.insert("command", "speaker_prev");
-            map.insert("value", true);
-            webSocketSendCommand(map);
-        } else if (command == MediaPlayerDef::C_NEXT) {
-            map.insert("command", "speaker_next");
-            map.insert("value", true);
-            webSocketSendCommand(map);
-        } else if (command == MediaPlayerDef::C_TURNON) {
-            map.insert("command", QVariant("onoff"));
-            map.insert("value", true);
-            webSocketSendCommand(map);
-        } else if (command == MediaPlayerDef::C_TURNOFF) {
-            map.insert("command", QVariant("onoff"));
-            map.insert("value", false);
-            webSocketSendCommand(map);
+    const HomeyCapabilityMap::Command *mapping = HomeyCapabilityMap::command(kind, command);
+    if (!mapping) {
+        return;
+    }
+
+    QByteArray message = HomeyCapabilityMap::message(*mapping, device, param);
+    if (message.isEmpty()) {
+        qCWarning(m_logCategory) << "Ignoring command" << command << "for" << entityId << "with invalid value" << param;
+        return;
+    }
+
+    if (kind == KIND_MEDIA_PLAYER && command == MediaPlayerDef::C_VOLUME_SET) {
+        QVariantMap attributes;
+        attributes.insert("volume", param);
+        m_entities->update(entityId, attributes);  // buggy homey fix
+
+        // the entity already shows the new volume: a following Homey update must not be skipped as unchanged
+        if (handle != m_entityHandles.end() && MediaPlayerDef::VOLUME < handle.value().attributes.size()) {
+            handle.value().attributes[MediaPlayerDef::VOLUME] = QVariant();
         }
     }
+
+    if (mapping->continuous) {
+        m_commandQueue->sendContinuous(device, HomeyCapabilityMap::capability(*mapping), message);
+    } else {
+        m_commandQueue->sendDiscrete(device, HomeyCapabilityMap::capability(*mapping), message);
+    }
 }
@@ -25,14 +25,34 @@
 #pragma once
 
 #include <QColor>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QHostAddress>
+#include <QHostInfo>
+#include <QJsonArray>
 #include <QLoggingCategory>
 #include <QObject>
+#include <QPointer>
+#include <QSet>
 #include <QString>
 #include <QThread>
 #include <QTimer>
 #include <QVariant>
+#include <QVector>
 #include <QtWebSockets/QWebSocket>
 
+#include "homeyalbumart.h"
+#include "homeybackoff.h"
+#include "homeycapabilities.h"
+#include "homeycommandqueue.h"
+#include "homeylinkmonitor.h"
+#include "homeymetrics.h"
+#include "homeyoutbox.h"
+#include "homeyrequesttracker.h"
+#include "homeyservicebrowser.h"
+#include "homeysnapshot.h"
+#include "homeystateupdate.h"
 #include "yio-interface/configinterface.h"
 #include "yio-interface/entities/entitiesinterface.h"
 #include "yio-interface/entities/entityinterface.h"
@@ -48,6 +68,63 @@
 
 const bool USE_WORKER_THREAD = true;
 
+// default port of the YIO app running on Homey
+const int DEFAULT_PORT = 8936;
+
+// default interval in ms for applying coalesced entity updates: one display frame
+const int DEFAULT_UPDATE_INTERVAL = 16;
+
+// default minimum interval in ms between two slider commands (brightness, volume, ...) for the same device
+const int DEFAULT_COMMAND_INTERVAL = 100;
+
+// mDNS service of the YIO app running on Homey, browsed at the mDNS multicast group by default
+const char MDNS_SERVICE[] = "_yio2homeyapi._tcp.local";
+const char DEFAULT_MDNS_ADDRESS[] = "224.0.0.251";
+const int  DEFAULT_MDNS_PORT = 5353;
+
+// default interval in ms for pinging an idle connection
+const int DEFAULT_PING_INTERVAL = 5000;
+
+// time in ms to wait for the answer of a ping before the connection is declared dead
+const int PING_TIMEOUT = 2000;
+
+// reconnect backoff in ms: the first retry is immediate, then from RECONNECT_MIN_DELAY up to RECONNECT_MAX_DELAY
+const int RECONNECT_MIN_DELAY = 500;
+const int RECONNECT_MAX_DELAY = 60000;
+
+// failed reconnect attempts before the user is notified, retries continue in the background
+const int RECONNECT_NOTIFY_ATTEMPTS = 3;
+
+// default maximum width and height in pixels of cached album art, 0 disables the album art cache
+const int DEFAULT_ALBUM_ART_SIZE = 480;
+
+// disk space in bytes for cached album art
+const qint64 ALBUM_ART_CACHE_BYTES = 8 * 1024 * 1024;
+
+// delay in ms for writing the entity snapshot after a change
+const int SNAPSHOT_INTERVAL = 60000;
+
+// default time in ms to wait for the acknowledgement of a command
+const int DEFAULT_COMMAND_TIMEOUT = 3000;
+
+// socket write backlog in bytes below which queued bulk messages are sent
+const int OUTBOX_LOW_WATER = 16 * 1024;
+
+// memory limit in bytes for queued bulk messages, the oldest are dropped first
+const int OUTBOX_BULK_LIMIT = 1024 * 1024;
+
+// number of event frames kept per device in standby before they are decoded
+const int STANDBY_FRAMES_PER_DEVICE = 8;
+
+// time in ms before a Homey device without a loaded entity is looked up again
+const int UNKNOWN_DEVICE_RETRY = 10000;
+
+// maximum time in ms spent registering entities before yielding to the event loop
+const int REGISTRATION_SLICE = 10;
+
+// separator of the hub id and the Homey deviceId in the entity IDs of a multi-hub integration
+const char HUB_SEPARATOR = ':';
+
 class HomeyPlugin : public Plugin {
     Q_OBJECT
     Q_INTERFACES(PluginInterface)
@@ -69,6 +146,8 @@ class HomeyPlugin : public Plugin {
 
 class Homey : public Integration {
     Q_OBJECT
+    Q_PROPERTY(int registeredEntities READ registeredEntities NOTIFY registrationProgressChanged)
+    Q_PROPERTY(int totalEntities READ totalEntities NOTIFY registrationProgressChanged)
 
  public:
     Homey(const QVariantMap& config, EntitiesInterface* entities, NotificationsInterface* notifications,
@@ -76,34 +155,226 @@ class Homey : public Integration {
 
     void sendCommand(const QString& type, const QString& entityId, int command, const QVariant& param) override;
 
+    // progress of the entity registration
+    int  registeredEntities() const { return m_registeredEntities; }
+    int  totalEntities() const { return m_catalog.size(); }
+    bool isRegisteringEntities() const { return m_registeredEntities < m_catalog.size(); }
+
+    // Round-trip statistics of sent commands: count, pending, retried, lost, p50, p95, p99 in ms. Must be called from
+    // the integration thread like metrics(), other threads get them in the "commands" entry of metricsReport.
+    Q_INVOKABLE QVariantMap commandStatistics() const;
+
+    // Runtime metrics: messages per type, bytes in / out, parse and update times, reconnects, outbound queues. Must be
+    // called from the integration thread, other threads get the values with the metricsReport signal.
+    Q_INVOKABLE QVariantMap metrics() const;
+
+ signals:
+    void registrationProgressChanged();
+    void metricsReport(const QVariantMap& metrics);
+
  public slots:
     void connect() override;
     void disconnect() override;
+    void enterStandby() override;
+    void leaveStandby() override;
 
     void onTextMessageReceived(const QString& message);
     void onStateChanged(QAbstractSocket::SocketState state);
     void onError(QAbstractSocket::SocketError error);
     void onTimeout();
+    void onUpdateTimeout();
+    void saveSnapshot();
+    void onRegistrationTimeout();
+    void onRequestResend(int id, const QByteArray& message);
+    void onRequestLost(const QString& deviceId);
+    void onMetricsTimeout();
+    void onLinkDead();
+    void onHostLookup(const QHostInfo& info);
+    void onEndpointFound(const QString& host, const QHostAddress& address, quint16 port);
+    void onAlbumArtReady(const QString& url, const QString& localUrl);
+    void onEntityDestroyed(QObject* object);
 
  private:
-    void webSocketSendCommand(const QVariantMap& data);
-    int  convertBrightnessToPercentage(float value);
+    // benchmarks of the update path, see tests/bench_hotpaths
+    friend class BenchHotPaths;
+
+    enum MessageType {
+        MSG_UNKNOWN,
+        MSG_EVENT,
+        MSG_SEND_STATES,
+        MSG_SEND_STATES_BATCH,
+        MSG_RESULT,
+        MSG_CONNECTED,
+        MSG_COMMAND,
+        MSG_SEND_ENTITIES,
+        MSG_COUNT
+    };
+
+    // optional protocol features announced by the Homey app in the connected message
+    enum ServerFeature : quint32 {
+        FEATURE_DELTA_SYNC = 1u << 0,
+        FEATURE_COMMAND_RESULT = 1u << 1,
+        FEATURE_SUBSCRIBE = 1u << 2,
+        FEATURE_STANDBY = 1u << 3
+    };
+
+    // Change of an entity, 'attribute' is HomeyCapabilityMap::STATE for the entity state. Only applied if 'object'
+    // still exists, the entity might be removed before the queued batch runs.
+    struct EntityMutation {
+        EntityInterface*  entity;
+        QPointer<QObject> object;
+        int               attribute;
+        QVariant          value;
+    };
+
+    // Resolved entity of a Homey device: avoids the entity lookup, type string compares and feature list searches
+    // for every update. 'features' is a bitmask indexed by the supported feature enum value of the entity type.
+    // 'state' and 'attributes' hold the values last pushed to the entity, unchanged values are not pushed again.
+    // 'object' is the QObject of the entity, null once the entity is destroyed.
+    struct EntityHandle {
+        EntityInterface*  entity = nullptr;
+        QPointer<QObject> object;
+        HomeyEntityKind   kind = KIND_UNKNOWN;
+        quint64           features = 0;
+        int               state = -1;
+        QVector<QVariant> attributes;
 
-    void updateEntity(const QString& entity_id, const QVariantMap& attr);
-    void updateLight(EntityInterface* entity, const QVariantMap& attr);
-    void updateBlind(EntityInterface* entity, const QVariantMap& attr);
-    void updateMediaPlayer(EntityInterface* entity, const QVariantMap& attr);
-    void updateClimate(EntityInterface* entity, const QVariantMap& attr);
-    void updateSwitch(EntityInterface* entity, const QVariantMap& attr);
+        bool isSupported(int feature) const { return (features & (Q_UINT64_C(1) << feature)) != 0; }
+    };
+
+    static MessageType messageType(const QString& type);
+    static quint32     serverFeatures(const QJsonArray& features);
+
+    EntityHandle resolveEntity(const QString& deviceId, EntityInterface* entity);
+    void         rebuildEntityHandles(const QList<EntityInterface*>& entities);
+
+    void setEntityState(EntityHandle& handle, int state);
+    void setEntityAttribute(EntityHandle& handle, int attribute, const QVariant& value);
+    void applyEntityMutations();
+
+    void openSocket();
+    void scheduleReconnect();
+    void lookupHost();
+
+    void              sendEntityIds();
+    bool              hasEntityIds(const QList<EntityInterface*>& entities) const;
+    void              setEntityIds(const QList<EntityInterface*>& entities);
+    void              addEntityId(const QString& entityId);
+    void              removeEntityId(const QString& entityId);
+    const QByteArray& entitiesReply();
+    void              sendSubscription();
+    void              addEntities(const QJsonArray& availableEntities);
+    void              startEntityRegistration();
+    void              registerEntity(const QVariantMap& catalogEntity);
+
+    // entities of this hub, YIO entity ID of a Homey deviceId and back
+    QList<EntityInterface*> loadedEntities();
+    QString                 entityId(const QString& deviceId) const;
+    QString                 deviceId(const QString& entityId) const;
+
+    void restoreSnapshot();
+    void scheduleSnapshot();
+
+    void webSocketSendCommand(const QString& deviceId, const QByteArray& capability, const QByteArray& message);
+
+    static QString eventDeviceId(const QByteArray& frame);
+    bool           deferEvent(const QByteArray& frame);
+    void           decodeDeferredEvents();
+    void           bufferEvent(const QByteArray& frame);
+    void           sendStandby();
+
+    void queueUpdate(const HomeyStateUpdate& update);
+    void queueUpdates(const QJsonArray& states);
+    void bufferUpdate(const HomeyStateUpdate& update);
+    void updateEntity(const HomeyStateUpdate& update);
+
+    static bool isRemoteImage(const QString& url);
+    QVariant    albumArt(const QString& entityId, const QString& url);
 
  private:
-    QString          m_ip;
-    QString          m_url;
-    QString          m_token;
-    QWebSocket*      m_webSocket;
-    QTimer*          m_wsReconnectTimer;
-    int              m_tries;
-    int              m_webSocketId;
-    bool             m_userDisconnect = false;
-    YioAPIInterface* m_api;
+    QString              m_ip;
+    QString              m_url;
+    QString              m_token;
+    QString              m_hubId;
+    QString              m_entityPrefix;
+    QWebSocket*          m_webSocket;
+    HomeyOutbox*         m_outbox;
+    QTimer*              m_wsReconnectTimer;
+    HomeyBackoff         m_backoff;
+    HomeyLinkMonitor*    m_linkMonitor;
+    QTimer*              m_updateTimer;
+    HomeyCommandQueue*   m_commandQueue;
+    QTimer*              m_snapshotTimer;
+    QTimer*              m_registrationTimer;
+    HomeyRequestTracker* m_requests;
+    QTimer*              m_metricsTimer;
+    bool                 m_reconnectNotified = false;
+    bool                 m_userDisconnect = false;
+    quint32              m_serverFeatures = 0;
+    YioAPIInterface*     m_api;
+
+    // pending entity updates, coalesced per entity_id until the next update tick
+    QHash<QString, HomeyStateUpdate> m_pendingUpdates;
+
+    // local album art cache, nullptr if disabled. Media players waiting for an image: entity_id to image URL.
+    HomeyAlbumArtCache*     m_albumArt = nullptr;
+    QHash<QString, QString> m_albumArtPending;
+
+    // entity changes of the current processing pass, handed to the entities' thread in one batch
+    QVector<EntityMutation> m_mutations;
+
+    // Homey deviceId to resolved entity of the loaded entities. Handles are dropped when their entity is destroyed,
+    // m_entityObjects maps the watched entity objects to their deviceId.
+    QHash<QString, EntityHandle> m_entityHandles;
+    QHash<QObject*, QString>     m_entityObjects;
+
+    // Homey deviceIds without a loaded entity and the time of the last lookup, looked up again after
+    // UNKNOWN_DEVICE_RETRY or when the loaded entities change
+    QHash<QString, qint64> m_unknownDevices;
+    QElapsedTimer          m_clock;
+
+    // Loaded entities of this integration and the getEntities reply. The device list is kept serialized: appended to
+    // when entities are added, serialized again when one is removed. The reply is reassembled from it when empty.
+    QStringList   m_entityIds;
+    QSet<QString> m_entityIdSet;
+    QByteArray    m_deviceList;
+    QByteArray    m_entitiesReply;
+
+    // last state revision applied to the entity of a Homey deviceId, sent on reconnect to only receive changed states
+    QHash<QString, qint64> m_revisions;
+
+    // In standby event frames are only assigned to their device and decoded when leaving standby, the entities are
+    // updated in one pass then.
+    bool                                m_standby = false;
+    QHash<QString, QVector<QByteArray>> m_standbyFrames;
+
+    // last subscription sent to the Homey app, only changes are sent again
+    QByteArray m_subscription;
+
+    // entity catalog and last known states of the loaded entities, persisted for the next startup
+    HomeySnapshot                    m_snapshot;
+    QVariantList                     m_catalog;
+    QHash<QString, HomeyStateUpdate> m_lastStates;
+    bool                             m_snapshotRestored = false;
+    bool                             m_snapshotDirty = false;
+
+    // catalog entries registered in this session by Homey deviceId: unchanged entries aren't registered again
+    QHash<QString, QVariantMap> m_registered;
+
+    // entity registration state: index into m_catalog and failures reported once registration finished
+    int         m_registeredEntities = 0;
+    QStringList m_unavailableEntities;
+    QStringList m_duplicateEntities;
+
+    HomeyMetrics  m_metrics;
+    QElapsedTimer m_disconnectedSince;
+
+    // resolved address of m_ip, used for connecting instead of resolving the hostname again
+    QHostAddress m_address;
+    int          m_hostLookupId = -1;
+
+    // Homey endpoint found with mDNS, persisted for connecting right away at the next start. Port 0 if unknown.
+    HomeyServiceBrowser* m_discovery = nullptr;
+    quint16              m_endpointPort = 0;
+    QString              m_endpointFile;
 };
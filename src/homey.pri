@@ -0,0 +1,30 @@
+# Sources of the Homey integration, shared by the plugin and the test targets
+INCLUDEPATH += $$PWD
+HEADERS  += $$PWD/homey.h \
+            $$PWD/homeyalbumart.h \
+            $$PWD/homeybackoff.h \
+            $$PWD/homeycapabilities.h \
+            $$PWD/homeycommand.h \
+            $$PWD/homeycommandqueue.h \
+            $$PWD/homeyhubs.h \
+            $$PWD/homeylinkmonitor.h \
+            $$PWD/homeymetrics.h \
+            $$PWD/homeyoutbox.h \
+            $$PWD/homeyrequesttracker.h \
+            $$PWD/homeyservicebrowser.h \
+            $$PWD/homeysnapshot.h \
+            $$PWD/homeystateupdate.h
+SOURCES  += $$PWD/homey.cpp \
+            $$PWD/homeyalbumart.cpp \
+            $$PWD/homeybackoff.cpp \
+            $$PWD/homeycapabilities.cpp \
+            $$PWD/homeycommand.cpp \
+            $$PWD/homeycommandqueue.cpp \
+            $$PWD/homeyhubs.cpp \
+            $$PWD/homeylinkmonitor.cpp \
+            $$PWD/homeymetrics.cpp \
+            $$PWD/homeyoutbox.cpp \
+            $$PWD/homeyrequesttracker.cpp \
+            $$PWD/homeyservicebrowser.cpp \
+            $$PWD/homeysnapshot.cpp \
+            $$PWD/homeystateupdate.cpp
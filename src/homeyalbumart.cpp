@@ -0,0 +1,180 @@
+/******************************************************************************
+ *
+ * Copyright (C) 2019-2020 Marton Borzak <hello@martonborzak.com>
+ *
+ * This file is part of the YIO-Remote software project.
+ *
+ * YIO-Remote software is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * YIO-Remote software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with YIO-Remote software. If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *****************************************************************************/
+
+#include "homeyalbumart.h"
+
+#include <QBuffer>
+#include <QCryptographicHash>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QImage>
+#include <QImageReader>
+#include <QNetworkRequest>
+#include <QStringList>
+#include <QUrl>
+
+HomeyAlbumArtCache::HomeyAlbumArtCache(const QString &directory, const QSize &size, qint64 budget, QObject *parent)
+    : QObject(parent), m_directory(directory), m_size(size), m_budget(budget) {
+    m_network = new QNetworkAccessManager(this);
+
+    // the index is not persisted: start without the images of the last session
+    QDir dir(m_directory);
+    for (const QString &fileName : dir.entryList(QStringList{"*.jpg"}, QDir::Files)) {
+        dir.remove(fileName);
+    }
+    QDir().mkpath(m_directory);
+
+    QObject::connect(m_network, &QNetworkAccessManager::finished, this, &HomeyAlbumArtCache::onFinished);
+}
+
+QString HomeyAlbumArtCache::image(const QString &url) {
+    QHash<QString, QByteArray>::const_iterator hash = m_urls.constFind(url);
+    if (hash != m_urls.constEnd()) {
+        QHash<QByteArray, Entry>::const_iterator entry = m_entries.constFind(hash.value());
+        if (entry != m_entries.constEnd()) {
+            touch(hash.value());
+            return QUrl::fromLocalFile(entry.value().fileName).toString();
+        }
+    }
+
+    fetch(url);
+    m_fetching[url] = false;
+    return QString();
+}
+
+void HomeyAlbumArtCache::prefetch(const QString &url) {
+    if (m_urls.contains(url)) {
+        return;
+    }
+    fetch(url);
+}
+
+void HomeyAlbumArtCache::fetch(const QString &url) {
+    if (m_fetching.contains(url)) {
+        return;
+    }
+    m_fetching.insert(url, true);
+
+    // the URL as given: QUrl normalizes it, the callers compare the original string
+    QNetworkRequest request{QUrl(url)};
+    request.setAttribute(QNetworkRequest::FollowRedirectsAttribute, true);
+    request.setAttribute(QNetworkRequest::User, url);
+    m_network->get(request);
+}
+
+void HomeyAlbumArtCache::onFinished(QNetworkReply *reply) {
+    reply->deleteLater();
+
+    QString url = reply->request().attribute(QNetworkRequest::User).toString();
+    bool    prefetch = m_fetching.take(url);
+
+    if (reply->error() != QNetworkReply::NoError) {
+        fail(url, prefetch);
+        return;
+    }
+
+    QByteArray data = reply->readAll();
+    QByteArray hash = QCryptographicHash::hash(data, QCryptographicHash::Sha1).toHex();
+
+    QString fileName;
+    QHash<QByteArray, Entry>::const_iterator entry = m_entries.constFind(hash);
+    if (entry != m_entries.constEnd()) {
+        // same image as another URL
+        fileName = entry.value().fileName;
+        touch(hash);
+    } else {
+        fileName = store(hash, data);
+        if (fileName.isEmpty()) {
+            fail(url, prefetch);
+            return;
+        }
+    }
+    m_urls.insert(url, hash);
+
+    if (!prefetch) {
+        emit ready(url, QUrl::fromLocalFile(fileName).toString());
+    }
+}
+
+void HomeyAlbumArtCache::fail(const QString &url, bool prefetch) {
+    // the entity falls back to the remote image instead of keeping the art of the previous track
+    if (!prefetch) {
+        emit ready(url, url);
+    }
+}
+
+QString HomeyAlbumArtCache::store(const QByteArray &hash, const QByteArray &data) {
+    QBuffer buffer;
+    buffer.setData(data);
+    buffer.open(QIODevice::ReadOnly);
+
+    QImageReader reader(&buffer);
+
+    // decode at the display size: a full size image is never kept in memory
+    QSize size = reader.size();
+    if (size.isValid() && (size.width() > m_size.width() || size.height() > m_size.height())) {
+        reader.setScaledSize(size.scaled(m_size, Qt::KeepAspectRatio));
+    }
+
+    QImage image = reader.read();
+    if (image.isNull()) {
+        return QString();
+    }
+
+    QString fileName = QDir(m_directory).filePath(QString::fromLatin1(hash) + ".jpg");
+    if (!image.save(fileName, "JPG", 85)) {
+        return QString();
+    }
+
+    qint64 bytes = QFileInfo(fileName).size();
+    m_entries.insert(hash, Entry{fileName, bytes});
+    m_lru.append(hash);
+    m_bytes += bytes;
+    evict();
+    return fileName;
+}
+
+void HomeyAlbumArtCache::touch(const QByteArray &hash) {
+    if (m_lru.isEmpty() || m_lru.last() != hash) {
+        m_lru.removeOne(hash);
+        m_lru.append(hash);
+    }
+}
+
+void HomeyAlbumArtCache::evict() {
+    // the newest image is always kept
+    while (m_bytes > m_budget && m_lru.size() > 1) {
+        QByteArray hash = m_lru.takeFirst();
+        Entry      entry = m_entries.take(hash);
+        QFile::remove(entry.fileName);
+        m_bytes -= entry.bytes;
+
+        for (QHash<QString, QByteArray>::iterator it = m_urls.begin(); it != m_urls.end();) {
+            if (it.value() == hash) {
+                it = m_urls.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+}
@@ -0,0 +1,80 @@
+/******************************************************************************
+ *
+ * Copyright (C) 2019-2020 Marton Borzak <hello@martonborzak.com>
+ *
+ * This file is part of the YIO-Remote software project.
+ *
+ * YIO-Remote software is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * YIO-Remote software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with YIO-Remote software. If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *****************************************************************************/
+
+#pragma once
+
+#include <QByteArray>
+#include <QHash>
+#include <QList>
+#include <QNetworkAccessManager>
+#include <QNetworkReply>
+#include <QObject>
+#include <QSize>
+#include <QString>
+
+// Album art cache. Images are downloaded once, downscaled to the display size while decoding and stored as local
+// files. Entries are keyed by the content hash: the same image behind different URLs, e.g. members of a Sonos group,
+// is stored once. The least recently used images are removed when the byte budget is exceeded.
+class HomeyAlbumArtCache : public QObject {
+    Q_OBJECT
+
+ public:
+    HomeyAlbumArtCache(const QString& directory, const QSize& size, qint64 budget, QObject* parent = nullptr);
+
+    // Local file URL of a cached image. Otherwise an empty string is returned, the image is downloaded and ready()
+    // is emitted once it's available. If the download or decoding fails, ready() passes the original URL instead.
+    QString image(const QString& url);
+
+    // downloads an image expected to be shown soon, e.g. the art of the next track
+    void prefetch(const QString& url);
+
+    qint64 bytes() const { return m_bytes; }
+    int    count() const { return m_entries.size(); }
+
+ signals:
+    void ready(const QString& url, const QString& localUrl);
+
+ private slots:
+    void onFinished(QNetworkReply* reply);
+
+ private:
+    struct Entry {
+        QString fileName;
+        qint64  bytes;
+    };
+
+    void    fetch(const QString& url);
+    void    fail(const QString& url, bool prefetch);
+    QString store(const QByteArray& hash, const QByteArray& data);
+    void    touch(const QByteArray& hash);
+    void    evict();
+
+    QString                    m_directory;
+    QSize                      m_size;
+    qint64                     m_budget;
+    qint64                     m_bytes = 0;
+    QNetworkAccessManager*     m_network;
+    QHash<QByteArray, Entry>   m_entries;   // content hash
+    QHash<QString, QByteArray> m_urls;      // URL to content hash
+    QList<QByteArray>          m_lru;       // content hashes, most recently used last
+    QHash<QString, bool>       m_fetching;  // URL in download, true if only prefetched
+};
@@ -0,0 +1,40 @@
+/******************************************************************************
+ *
+ * Copyright (C) 2019-2020 Marton Borzak <hello@martonborzak.com>
+ *
+ * This file is part of the YIO-Remote software project.
+ *
+ * YIO-Remote software is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * YIO-Remote software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with YIO-Remote software. If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *****************************************************************************/
+
+#include "homeybackoff.h"
+
+#include <QRandomGenerator>
+
+int HomeyBackoff::next() {
+    int attempt = m_attempts++;
+    if (attempt == 0) {
+        return 0;
+    }
+
+    // initial * 2^(attempt - 1), jittered to [delay / 2, delay]: clients losing the link together don't retry in sync
+    qint64 delay = m_maximum;
+    if (attempt <= 20) {
+        delay = qMin(static_cast<qint64>(m_maximum), static_cast<qint64>(m_initial) << (attempt - 1));
+    }
+    int half = static_cast<int>(delay / 2);
+    return half + QRandomGenerator::global()->bounded(half + 1);
+}
@@ -0,0 +1,40 @@
+/******************************************************************************
+ *
+ * Copyright (C) 2019-2020 Marton Borzak <hello@martonborzak.com>
+ *
+ * This file is part of the YIO-Remote software project.
+ *
+ * YIO-Remote software is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * YIO-Remote software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with YIO-Remote software. If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *****************************************************************************/
+
+#pragma once
+
+// Reconnect delays: the first retry is immediate, then exponential backoff with jitter up to 'maximum' ms. There is
+// no last attempt: once at the maximum, retries continue at that interval.
+class HomeyBackoff {
+ public:
+    HomeyBackoff(int initial, int maximum) : m_initial(initial), m_maximum(maximum) {}
+
+    // delay in ms for the next attempt
+    int  next();
+    int  attempts() const { return m_attempts; }
+    void reset() { m_attempts = 0; }
+
+ private:
+    int m_initial;
+    int m_maximum;
+    int m_attempts = 0;
+};
@@ -0,0 +1,261 @@
+/******************************************************************************
+ *
+ * Copyright (C) 2019-2020 Marton Borzak <hello@martonborzak.com>
+ *
+ * This file is part of the YIO-Remote software project.
+ *
+ * YIO-Remote software is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * YIO-Remote software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with YIO-Remote software. If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *****************************************************************************/
+
+#include "homeycapabilities.h"
+
+#include <QColor>
+#include <QtNumeric>
+#include <vector>
+
+#include "yio-interface/entities/blindinterface.h"
+#include "yio-interface/entities/climateinterface.h"
+#include "yio-interface/entities/lightinterface.h"
+#include "yio-interface/entities/mediaplayerinterface.h"
+#include "yio-interface/entities/switchinterface.h"
+
+typedef HomeyCapabilityMap Map;
+typedef HomeyStateUpdate   StateUpdate;
+
+// example command: {"type":"command","command":"onoff","value":true,"deviceId":"78f3ab16-c622-4bd7-aebf-3ca981e41375"}
+static constexpr Map::Command COMMANDS[] = {
+    {KIND_LIGHT, LightDef::C_TOGGLE, "toggle", "true", Map::T_FIXED, false},
+    {KIND_LIGHT, LightDef::C_ON, "onoff", "true", Map::T_FIXED, false},
+    {KIND_LIGHT, LightDef::C_OFF, "onoff", "false", Map::T_FIXED, false},
+    {KIND_LIGHT, LightDef::C_BRIGHTNESS, "dim", nullptr, Map::T_PERCENT, true},
+    {KIND_LIGHT, LightDef::C_COLOR, "color", nullptr, Map::T_RGB, true},
+
+    {KIND_BLIND, BlindDef::C_OPEN, "windowcoverings_closed", "\"false\"", Map::T_FIXED, false},
+    {KIND_BLIND, BlindDef::C_CLOSE, "windowcoverings_closed", "\"true\"", Map::T_FIXED, false},
+    {KIND_BLIND, BlindDef::C_STOP, "windowcoverings_tilt_set", "0", Map::T_FIXED, false},
+    {KIND_BLIND, BlindDef::C_POSITION, "windowcoverings_set", nullptr, Map::T_PERCENT, true},
+
+    {KIND_MEDIA_PLAYER, MediaPlayerDef::C_VOLUME_SET, "volume_set", nullptr, Map::T_PERCENT, true},
+    {KIND_MEDIA_PLAYER, MediaPlayerDef::C_PLAY, "speaker_playing", "true", Map::T_FIXED, false},
+    {KIND_MEDIA_PLAYER, MediaPlayerDef::C_STOP, "speaker_playing", "false", Map::T_FIXED, false},
+    {KIND_MEDIA_PLAYER, MediaPlayerDef::C_PAUSE, "speaker_playing", "false", Map::T_FIXED, false},
+    {KIND_MEDIA_PLAYER, MediaPlayerDef::C_PREVIOUS, "speaker_prev", "true", Map::T_FIXED, false},
+    {KIND_MEDIA_PLAYER, MediaPlayerDef::C_NEXT, "speaker_next", "true", Map::T_FIXED, false},
+    {KIND_MEDIA_PLAYER, MediaPlayerDef::C_TURNON, "onoff", "true", Map::T_FIXED, false},
+    {KIND_MEDIA_PLAYER, MediaPlayerDef::C_TURNOFF, "onoff", "false", Map::T_FIXED, false},
+
+    {KIND_CLIMATE, ClimateDef::C_ON, "onoff", "true", Map::T_FIXED, false},
+    {KIND_CLIMATE, ClimateDef::C_OFF, "onoff", "false", Map::T_FIXED, false},
+    {KIND_CLIMATE, ClimateDef::C_TARGET_TEMPERATURE, "target_temperature", nullptr, Map::T_NUMBER, true},
+
+    {KIND_SWITCH, SwitchDef::C_TOGGLE, "toggle", "true", Map::T_FIXED, false},
+    {KIND_SWITCH, SwitchDef::C_ON, "onoff", "true", Map::T_FIXED, false},
+    {KIND_SWITCH, SwitchDef::C_OFF, "onoff", "false", Map::T_FIXED, false},
+};
+
+static constexpr Map::Attribute ATTRIBUTES[] = {
+    {KIND_LIGHT, StateUpdate::ONOFF, Map::STATE, Map::T_STATE, -1, LightDef::ON, LightDef::OFF},
+    {KIND_LIGHT, StateUpdate::DIM, LightDef::BRIGHTNESS, Map::T_PERCENT, LightDef::F_BRIGHTNESS, 0, 0},
+    {KIND_LIGHT, StateUpdate::RGB_COLOR, LightDef::COLOR, Map::T_RGB, LightDef::F_COLOR, 0, 0},
+
+    {KIND_BLIND, StateUpdate::WINDOWCOVERINGS_CLOSED, Map::STATE, Map::T_STATE, -1, BlindDef::CLOSED, BlindDef::OPEN},
+    {KIND_BLIND, StateUpdate::WINDOWCOVERINGS_SET, BlindDef::POSITION, Map::T_PERCENT, BlindDef::F_POSITION, 0, 0},
+
+    {KIND_MEDIA_PLAYER, StateUpdate::ONOFF, Map::STATE, Map::T_STATE, -1, MediaPlayerDef::ON, MediaPlayerDef::OFF},
+    {KIND_MEDIA_PLAYER, StateUpdate::SPEAKER_PLAYING, Map::STATE, Map::T_STATE, -1, MediaPlayerDef::PLAYING,
+     MediaPlayerDef::IDLE},
+    {KIND_MEDIA_PLAYER, StateUpdate::VOLUME_SET, MediaPlayerDef::VOLUME, Map::T_PERCENT, -1, 0, 0},
+    {KIND_MEDIA_PLAYER, StateUpdate::MEDIA_CONTENT_TYPE, MediaPlayerDef::MEDIATYPE, Map::T_TEXT,
+     MediaPlayerDef::F_MEDIA_TYPE, 0, 0},
+    {KIND_MEDIA_PLAYER, StateUpdate::ALBUM_ART, MediaPlayerDef::MEDIAIMAGE, Map::T_IMAGE, -1, 0, 0},
+    {KIND_MEDIA_PLAYER, StateUpdate::NEXT_ALBUM_ART, MediaPlayerDef::MEDIAIMAGE, Map::T_PREFETCH, -1, 0, 0},
+    {KIND_MEDIA_PLAYER, StateUpdate::SPEAKER_TRACK, MediaPlayerDef::MEDIATITLE, Map::T_TEXT, -1, 0, 0},
+    {KIND_MEDIA_PLAYER, StateUpdate::SPEAKER_ARTIST, MediaPlayerDef::MEDIAARTIST, Map::T_TEXT, -1, 0, 0},
+
+    {KIND_CLIMATE, StateUpdate::ONOFF, Map::STATE, Map::T_STATE, -1, ClimateDef::ON, ClimateDef::OFF},
+    {KIND_CLIMATE, StateUpdate::TARGET_TEMPERATURE, ClimateDef::TARGET_TEMPERATURE, Map::T_NUMBER,
+     ClimateDef::F_TARGET_TEMPERATURE, 0, 0},
+    {KIND_CLIMATE, StateUpdate::MEASURE_TEMPERATURE, ClimateDef::TEMPERATURE, Map::T_NUMBER,
+     ClimateDef::F_TEMPERATURE, 0, 0},
+
+    {KIND_SWITCH, StateUpdate::ONOFF, Map::STATE, Map::T_STATE, -1, SwitchDef::ON, SwitchDef::OFF},
+};
+
+static constexpr int COMMAND_COUNT = sizeof(COMMANDS) / sizeof(COMMANDS[0]);
+static constexpr int ATTRIBUTE_COUNT = sizeof(ATTRIBUTES) / sizeof(ATTRIBUTES[0]);
+
+// upper bound of the command enum values of all entity types
+static constexpr int MAX_COMMANDS = 128;
+
+// lookup tables built by the compiler: index into COMMANDS / ATTRIBUTES, -1 if not mapped
+struct CommandIndex {
+    qint8 index[KIND_COUNT][MAX_COMMANDS];
+};
+
+struct AttributeIndex {
+    qint8 index[KIND_COUNT][StateUpdate::CAPABILITY_COUNT];
+};
+
+static constexpr int capabilityBit(quint32 capability) {
+    int bit = 0;
+    while (capability > 1) {
+        capability >>= 1;
+        bit++;
+    }
+    return bit;
+}
+
+static constexpr bool validTables() {
+    for (int i = 0; i < COMMAND_COUNT; i++) {
+        if (COMMANDS[i].command < 0 || COMMANDS[i].command >= MAX_COMMANDS) {
+            return false;
+        }
+    }
+    for (int i = 0; i < ATTRIBUTE_COUNT; i++) {
+        if (capabilityBit(ATTRIBUTES[i].capability) >= StateUpdate::CAPABILITY_COUNT || ATTRIBUTES[i].feature >= 64) {
+            return false;
+        }
+    }
+    return COMMAND_COUNT < 128 && ATTRIBUTE_COUNT < 128;
+}
+
+static_assert(validTables(), "Homey capability mapping out of range of the lookup tables");
+
+static constexpr CommandIndex buildCommandIndex() {
+    CommandIndex table{};
+    for (int kind = 0; kind < KIND_COUNT; kind++) {
+        for (int command = 0; command < MAX_COMMANDS; command++) {
+            table.index[kind][command] = -1;
+        }
+    }
+    for (int i = 0; i < COMMAND_COUNT; i++) {
+        table.index[COMMANDS[i].kind][COMMANDS[i].command] = static_cast<qint8>(i);
+    }
+    return table;
+}
+
+static constexpr AttributeIndex buildAttributeIndex() {
+    AttributeIndex table{};
+    for (int kind = 0; kind < KIND_COUNT; kind++) {
+        for (int bit = 0; bit < StateUpdate::CAPABILITY_COUNT; bit++) {
+            table.index[kind][bit] = -1;
+        }
+    }
+    for (int i = 0; i < ATTRIBUTE_COUNT; i++) {
+        table.index[ATTRIBUTES[i].kind][capabilityBit(ATTRIBUTES[i].capability)] = static_cast<qint8>(i);
+    }
+    return table;
+}
+
+static constexpr CommandIndex   COMMAND_INDEX = buildCommandIndex();
+static constexpr AttributeIndex ATTRIBUTE_INDEX = buildAttributeIndex();
+
+// pre-serialized messages of the COMMANDS, same index
+static const std::vector<HomeyCommandTemplate>& commandTemplates() {
+    static const std::vector<HomeyCommandTemplate> templates = [] {
+        std::vector<HomeyCommandTemplate> list;
+        list.reserve(COMMAND_COUNT);
+        for (const Map::Command& command : COMMANDS) {
+            if (command.transform == Map::T_FIXED) {
+                list.emplace_back(command.capability, command.value);
+            } else {
+                list.emplace_back(command.capability);
+            }
+        }
+        return list;
+    }();
+    return templates;
+}
+
+HomeyEntityKind HomeyCapabilityMap::entityKind(const QString &type) {
+    if (type == QLatin1String("light")) {
+        return KIND_LIGHT;
+    }
+    if (type == QLatin1String("blind")) {
+        return KIND_BLIND;
+    }
+    if (type == QLatin1String("media_player")) {
+        return KIND_MEDIA_PLAYER;
+    }
+    if (type == QLatin1String("climate")) {
+        return KIND_CLIMATE;
+    }
+    if (type == QLatin1String("switch")) {
+        return KIND_SWITCH;
+    }
+    return KIND_UNKNOWN;
+}
+
+const HomeyCapabilityMap::Command *HomeyCapabilityMap::command(HomeyEntityKind kind, int command) {
+    if (command < 0 || command >= MAX_COMMANDS) {
+        return nullptr;
+    }
+    int index = COMMAND_INDEX.index[kind][command];
+    return index < 0 ? nullptr : &COMMANDS[index];
+}
+
+const HomeyCapabilityMap::Attribute *HomeyCapabilityMap::attribute(HomeyEntityKind kind, int capabilityBit) {
+    if (capabilityBit < 0 || capabilityBit >= StateUpdate::CAPABILITY_COUNT) {
+        return nullptr;
+    }
+    int index = ATTRIBUTE_INDEX.index[kind][capabilityBit];
+    return index < 0 ? nullptr : &ATTRIBUTES[index];
+}
+
+const QByteArray &HomeyCapabilityMap::capability(const Command &command) {
+    return commandTemplates()[static_cast<size_t>(&command - COMMANDS)].capability();
+}
+
+QByteArray HomeyCapabilityMap::message(const Command &command, const QString &deviceId, const QVariant &param) {
+    const HomeyCommandTemplate &commandTemplate = commandTemplates()[static_cast<size_t>(&command - COMMANDS)];
+
+    switch (command.transform) {
+        case T_PERCENT:
+        case T_NUMBER: {
+            // a NaN or infinite value from a slider or a calculation would set the device to null
+            double value = command.transform == T_PERCENT ? param.toDouble() / 100 : param.toDouble();
+            if (!qIsFinite(value)) {
+                return QByteArray();
+            }
+            return commandTemplate.message(deviceId, HomeyCommandTemplate::number(value));
+        }
+        case T_RGB: {
+            QColor     color = param.value<QColor>();
+            QByteArray value = HomeyCommandTemplate::rgb(color.red(), color.green(), color.blue());
+            return commandTemplate.message(deviceId, value);
+        }
+        default:
+            return commandTemplate.message(deviceId);
+    }
+}
+
+int HomeyCapabilityMap::state(const Attribute &attribute, const HomeyStateUpdate &update) {
+    return update.flag(attribute.capability) ? attribute.onState : attribute.offState;
+}
+
+QVariant HomeyCapabilityMap::value(const Attribute &attribute, const HomeyStateUpdate &update) {
+    switch (attribute.transform) {
+        case T_PERCENT:
+            return qRound(update.number(attribute.capability) * 100);
+        case T_NUMBER:
+            return update.number(attribute.capability);
+        case T_STATE:
+            return state(attribute, update);
+        default:
+            // T_TEXT, T_RGB, T_IMAGE, T_PREFETCH
+            return update.text(attribute.capability);
+    }
+}
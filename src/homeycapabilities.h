@@ -0,0 +1,85 @@
+/******************************************************************************
+ *
+ * Copyright (C) 2019-2020 Marton Borzak <hello@martonborzak.com>
+ *
+ * This file is part of the YIO-Remote software project.
+ *
+ * YIO-Remote software is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * YIO-Remote software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with YIO-Remote software. If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *****************************************************************************/
+
+#pragma once
+
+#include <QByteArray>
+#include <QString>
+#include <QVariant>
+
+#include "homeycommand.h"
+#include "homeystateupdate.h"
+
+// entity types handled by the integration, entities of other types are ignored
+enum HomeyEntityKind { KIND_UNKNOWN, KIND_LIGHT, KIND_BLIND, KIND_MEDIA_PLAYER, KIND_CLIMATE, KIND_SWITCH, KIND_COUNT };
+
+// Compile-time mapping between the YIO entity commands and attributes and the Homey capabilities. Commands are looked
+// up by entity kind and command, received capabilities by entity kind and capability: both are a single array access.
+class HomeyCapabilityMap {
+ public:
+    enum Transform {
+        T_FIXED,    // command: fixed JSON value of the mapping
+        T_PERCENT,  // 0..100 on the entity, 0..1 on Homey
+        T_NUMBER,
+        T_RGB,      // QColor command parameter, #RRGGBB attribute
+        T_TEXT,
+        T_STATE,    // boolean capability to one of two entity states
+        T_IMAGE,    // image URL, replaced by the local album art cache
+        T_PREFETCH  // image URL to download for later use, not pushed to the entity
+    };
+
+    // attribute index of the entity state
+    static const int STATE = -1;
+
+    struct Command {
+        HomeyEntityKind kind;
+        int             command;
+        const char*     capability;
+        const char*     value;  // JSON value for T_FIXED
+        Transform       transform;
+        bool            continuous;  // slider values: rate limited per device, only the latest value is sent
+    };
+
+    struct Attribute {
+        HomeyEntityKind              kind;
+        HomeyStateUpdate::Capability capability;
+        int                          attribute;  // STATE or the attribute index of the entity type
+        Transform                    transform;
+        int                          feature;   // feature the entity must support, -1 if none
+        int                          onState;   // T_STATE: state for a true value
+        int                          offState;  // T_STATE: state for a false value
+    };
+
+    static HomeyEntityKind entityKind(const QString& type);
+
+    // nullptr if the command or capability is not mapped for the entity kind
+    static const Command*   command(HomeyEntityKind kind, int command);
+    static const Attribute* attribute(HomeyEntityKind kind, int capabilityBit);
+
+    // command message for the Homey app, empty if the parameter is not a finite number for a numeric command
+    static const QByteArray& capability(const Command& command);
+    static QByteArray        message(const Command& command, const QString& deviceId, const QVariant& param);
+
+    // value of a received capability for the entity
+    static int      state(const Attribute& attribute, const HomeyStateUpdate& update);
+    static QVariant value(const Attribute& attribute, const HomeyStateUpdate& update);
+};
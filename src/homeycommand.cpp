@@ -0,0 +1,109 @@
+/******************************************************************************
+ *
+ * Copyright (C) 2019-2020 Marton Borzak <hello@martonborzak.com>
+ *
+ * This file is part of the YIO-Remote software project.
+ *
+ * YIO-Remote software is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * YIO-Remote software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with YIO-Remote software. If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *****************************************************************************/
+
+#include "homeycommand.h"
+
+#include <QLocale>
+#include <QtNumeric>
+
+static const char DEVICE_ID_KEY[] = ",\"deviceId\":";
+
+HomeyCommandTemplate::HomeyCommandTemplate(const char *capability) : m_capability(capability) {
+    m_head.append("{\"type\":\"command\",\"command\":\"").append(capability).append("\",\"value\":");
+}
+
+HomeyCommandTemplate::HomeyCommandTemplate(const char *capability, const char *value)
+    : HomeyCommandTemplate(capability) {
+    m_head.append(value).append(DEVICE_ID_KEY);
+}
+
+QByteArray HomeyCommandTemplate::message(const QString &deviceId) const {
+    QByteArray out;
+    out.reserve(m_head.size() + deviceId.size() + 4);
+    out.append(m_head);
+    appendString(&out, deviceId);
+    out.append('}');
+    return out;
+}
+
+QByteArray HomeyCommandTemplate::message(const QString &deviceId, const QByteArray &value) const {
+    QByteArray out;
+    out.reserve(m_head.size() + value.size() + static_cast<int>(sizeof(DEVICE_ID_KEY)) + deviceId.size() + 4);
+    out.append(m_head).append(value).append(DEVICE_ID_KEY);
+    appendString(&out, deviceId);
+    out.append('}');
+    return out;
+}
+
+QByteArray HomeyCommandTemplate::number(double value) {
+    // same representation as QJsonDocument: JSON has no NaN or infinity
+    if (!qIsFinite(value)) {
+        return QByteArrayLiteral("null");
+    }
+    return QByteArray::number(value, 'g', QLocale::FloatingPointShortest);
+}
+
+QByteArray HomeyCommandTemplate::rgb(int red, int green, int blue) {
+    QByteArray out;
+    out.reserve(13);
+    out.append('[')
+        .append(QByteArray::number(red))
+        .append(',')
+        .append(QByteArray::number(green))
+        .append(',')
+        .append(QByteArray::number(blue))
+        .append(']');
+    return out;
+}
+
+void HomeyCommandTemplate::appendString(QByteArray *out, const QString &value) {
+    static const char hex[] = "0123456789abcdef";
+
+    out->append('"');
+    const QByteArray utf8 = value.toUtf8();
+    for (char c : utf8) {
+        switch (c) {
+            case '"':
+                out->append("\\\"");
+                break;
+            case '\\':
+                out->append("\\\\");
+                break;
+            case '\n':
+                out->append("\\n");
+                break;
+            case '\r':
+                out->append("\\r");
+                break;
+            case '\t':
+                out->append("\\t");
+                break;
+            default:
+                if (static_cast<unsigned char>(c) < 0x20) {
+                    out->append("\\u00").append(hex[(c >> 4) & 0xF]).append(hex[c & 0xF]);
+                } else {
+                    out->append(c);
+                }
+        }
+    }
+    out->append('"');
+}
@@ -0,0 +1,50 @@
+/******************************************************************************
+ *
+ * Copyright (C) 2019-2020 Marton Borzak <hello@martonborzak.com>
+ *
+ * This file is part of the YIO-Remote software project.
+ *
+ * YIO-Remote software is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * YIO-Remote software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with YIO-Remote software. If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *****************************************************************************/
+
+#pragma once
+
+#include <QByteArray>
+#include <QString>
+
+// Pre-serialized Homey command message. Only the value (if not fixed) and the deviceId are filled in per command:
+// {"type":"command","command":"<capability>","value":<value>,"deviceId":"<deviceId>"}
+class HomeyCommandTemplate {
+ public:
+    // template for a capability with a value given per command
+    explicit HomeyCommandTemplate(const char* capability);
+    // template for a capability with a fixed JSON value, e.g. "true"
+    HomeyCommandTemplate(const char* capability, const char* value);
+
+    const QByteArray& capability() const { return m_capability; }
+
+    QByteArray message(const QString& deviceId) const;
+    QByteArray message(const QString& deviceId, const QByteArray& value) const;
+
+    // null for NaN and infinity
+    static QByteArray number(double value);
+    static QByteArray rgb(int red, int green, int blue);
+    static void       appendString(QByteArray* out, const QString& value);
+
+ private:
+    QByteArray m_capability;
+    QByteArray m_head;
+};
@@ -0,0 +1,128 @@
+/******************************************************************************
+ *
+ * Copyright (C) 2019-2020 Marton Borzak <hello@martonborzak.com>
+ *
+ * This file is part of the YIO-Remote software project.
+ *
+ * YIO-Remote software is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * YIO-Remote software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with YIO-Remote software. If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *****************************************************************************/
+
+#include "homeycommandqueue.h"
+
+HomeyCommandQueue::HomeyCommandQueue(int interval, QObject *parent) : QObject(parent), m_interval(interval) {
+    m_timer = new QTimer(this);
+    m_timer->setSingleShot(true);
+    m_clock.start();
+
+    QObject::connect(m_timer, &QTimer::timeout, this, &HomeyCommandQueue::onTimeout);
+}
+
+void HomeyCommandQueue::sendContinuous(const QString &deviceId, const QByteArray &capability,
+                                       const QByteArray &command) {
+    QString key = deviceId + QLatin1Char('/') + QLatin1String(capability);
+
+    // latest value wins while waiting for the next send slot
+    QHash<QString, Pending>::iterator pending = m_pending.find(key);
+    if (pending != m_pending.end()) {
+        pending.value().command = command;
+        return;
+    }
+
+    qint64                                now = m_clock.elapsed();
+    QHash<QString, qint64>::const_iterator last = m_lastSent.constFind(key);
+    if (m_interval <= 0 || last == m_lastSent.constEnd() || now - last.value() >= m_interval) {
+        m_lastSent.insert(key, now);
+        emit send(deviceId, capability, command);
+        return;
+    }
+
+    m_pending.insert(key, Pending{deviceId, capability, command, last.value() + m_interval});
+    schedule(now);
+}
+
+void HomeyCommandQueue::sendDiscrete(const QString &deviceId, const QByteArray &capability, const QByteArray &command) {
+    // keep the order of commands per device: e.g. a final dim value must not be sent after a following "off"
+    flushDevice(deviceId);
+    emit send(deviceId, capability, command);
+}
+
+void HomeyCommandQueue::clear() {
+    m_timer->stop();
+    m_pending.clear();
+    m_lastSent.clear();
+}
+
+void HomeyCommandQueue::onTimeout() {
+    qint64 now = m_clock.elapsed();
+
+    QHash<QString, Pending>::iterator it = m_pending.begin();
+    while (it != m_pending.end()) {
+        if (it.value().due <= now) {
+            Pending pending = it.value();
+            m_lastSent.insert(it.key(), now);
+            it = m_pending.erase(it);
+            emit send(pending.deviceId, pending.capability, pending.command);
+        } else {
+            ++it;
+        }
+    }
+
+    // forget send times which no longer throttle anything
+    QHash<QString, qint64>::iterator last = m_lastSent.begin();
+    while (last != m_lastSent.end()) {
+        if (now - last.value() >= m_interval && !m_pending.contains(last.key())) {
+            last = m_lastSent.erase(last);
+        } else {
+            ++last;
+        }
+    }
+
+    schedule(now);
+}
+
+void HomeyCommandQueue::flushDevice(const QString &deviceId) {
+    if (m_pending.isEmpty()) {
+        return;
+    }
+
+    qint64                            now = m_clock.elapsed();
+    QHash<QString, Pending>::iterator it = m_pending.begin();
+    while (it != m_pending.end()) {
+        if (it.value().deviceId == deviceId) {
+            Pending pending = it.value();
+            m_lastSent.insert(it.key(), now);
+            it = m_pending.erase(it);
+            emit send(pending.deviceId, pending.capability, pending.command);
+        } else {
+            ++it;
+        }
+    }
+
+    schedule(now);
+}
+
+void HomeyCommandQueue::schedule(qint64 now) {
+    if (m_pending.isEmpty()) {
+        m_timer->stop();
+        return;
+    }
+
+    qint64 due = m_pending.constBegin().value().due;
+    for (const Pending &pending : m_pending) {
+        due = qMin(due, pending.due);
+    }
+    m_timer->start(static_cast<int>(qMax(Q_INT64_C(0), due - now)));
+}
@@ -0,0 +1,73 @@
+/******************************************************************************
+ *
+ * Copyright (C) 2019-2020 Marton Borzak <hello@martonborzak.com>
+ *
+ * This file is part of the YIO-Remote software project.
+ *
+ * YIO-Remote software is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * YIO-Remote software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with YIO-Remote software. If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *****************************************************************************/
+
+#pragma once
+
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QObject>
+#include <QString>
+#include <QTimer>
+
+// Outbound command queue. Continuous commands (slider values like dim or volume_set) are rate limited per device and
+// capability: only the newest value is kept while waiting and the final value is always sent. Discrete commands are
+// never dropped and sent in order, after any pending continuous value of the same device.
+class HomeyCommandQueue : public QObject {
+    Q_OBJECT
+
+ public:
+    explicit HomeyCommandQueue(int interval, QObject* parent = nullptr);
+
+    void sendContinuous(const QString& deviceId, const QByteArray& capability, const QByteArray& command);
+    void sendDiscrete(const QString& deviceId, const QByteArray& capability, const QByteArray& command);
+
+    // number of continuous values waiting for their send slot
+    int pending() const { return m_pending.size(); }
+
+    // drops all pending continuous values
+    void clear();
+
+ signals:
+    void send(const QString& deviceId, const QByteArray& capability, const QByteArray& command);
+
+ private slots:
+    void onTimeout();
+
+ private:
+    struct Pending {
+        QString    deviceId;
+        QByteArray capability;
+        QByteArray command;
+        qint64     due;
+    };
+
+    void flushDevice(const QString& deviceId);
+    void schedule(qint64 now);
+
+ private:
+    int                     m_interval;
+    QTimer*                 m_timer;
+    QElapsedTimer           m_clock;
+    QHash<QString, Pending> m_pending;
+    QHash<QString, qint64>  m_lastSent;
+};
@@ -0,0 +1,128 @@
+/******************************************************************************
+ *
+ * Copyright (C) 2019-2020 Marton Borzak <hello@martonborzak.com>
+ *
+ * This file is part of the YIO-Remote software project.
+ *
+ * YIO-Remote software is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * YIO-Remote software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with YIO-Remote software. If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *****************************************************************************/
+
+#include "homeyhubs.h"
+
+#include <QtDebug>
+
+HomeyHubs::HomeyHubs(const QVariantMap &config, EntitiesInterface *entities, NotificationsInterface *notifications,
+                     YioAPIInterface *api, ConfigInterface *configObj, Plugin *plugin)
+    : Integration(config, entities, notifications, api, configObj, plugin) {
+    QVariantMap        data = config.value(Integration::OBJ_DATA).toMap();
+    const QVariantList hubs = data.take("hubs").toList();
+
+    for (int i = 0; i < hubs.size(); i++) {
+        // settings of the hub on top of the common ones
+        const QVariantMap hub = hubs.at(i).toMap();
+        QVariantMap       hubData = data;
+        for (QVariantMap::const_iterator it = hub.constBegin(); it != hub.constEnd(); ++it) {
+            hubData.insert(it.key(), it.value());
+        }
+
+        QString id = hubData.take("id").toString();
+        if (id.isEmpty()) {
+            id = QString::number(i + 1);
+        }
+        if (id.contains(HUB_SEPARATOR) || m_hubs.contains(id)) {
+            qCWarning(m_logCategory) << "Ignoring Homey hub with invalid or duplicate id:" << id;
+            continue;
+        }
+        hubData.insert("hub", id);
+
+        // same integration id: the entities of all hubs belong to this integration and get their commands from it
+        QVariantMap hubConfig = config;
+        hubConfig.insert(Integration::OBJ_DATA, hubData);
+        Homey *homey = new Homey(hubConfig, entities, notifications, api, configObj, plugin);
+        homey->setParent(this);
+        QObject::connect(homey, &Integration::stateChanged, this, &HomeyHubs::onHubStateChanged);
+        m_hubs.insert(id, homey);
+    }
+
+    qCInfo(m_logCategory) << "Homey integration with" << m_hubs.size() << "hubs:" << m_hubs.keys();
+}
+
+void HomeyHubs::sendCommand(const QString &type, const QString &entityId, int command, const QVariant &param) {
+    Homey *hub = m_hubs.value(entityId.left(entityId.indexOf(HUB_SEPARATOR)));
+    if (!hub) {
+        qCWarning(m_logCategory) << "No Homey hub for entity" << entityId;
+        return;
+    }
+    hub->sendCommand(type, entityId, command, param);
+}
+
+QVariantMap HomeyHubs::commandStatistics() const {
+    QVariantMap map;
+    for (QMap<QString, Homey *>::const_iterator it = m_hubs.constBegin(); it != m_hubs.constEnd(); ++it) {
+        map.insert(it.key(), it.value()->commandStatistics());
+    }
+    return map;
+}
+
+QVariantMap HomeyHubs::metrics() const {
+    QVariantMap map;
+    for (QMap<QString, Homey *>::const_iterator it = m_hubs.constBegin(); it != m_hubs.constEnd(); ++it) {
+        map.insert(it.key(), it.value()->metrics());
+    }
+    return map;
+}
+
+void HomeyHubs::connect() {
+    for (Homey *hub : m_hubs) {
+        hub->connect();
+    }
+}
+
+void HomeyHubs::disconnect() {
+    for (Homey *hub : m_hubs) {
+        hub->disconnect();
+    }
+}
+
+void HomeyHubs::enterStandby() {
+    for (Homey *hub : m_hubs) {
+        hub->enterStandby();
+    }
+}
+
+void HomeyHubs::leaveStandby() {
+    for (Homey *hub : m_hubs) {
+        hub->leaveStandby();
+    }
+}
+
+void HomeyHubs::onHubStateChanged() {
+    // Connected as long as one hub is: a hub being down doesn't take the others with it, it reconnects on its own
+    // and notifies the user with its id.
+    int state = DISCONNECTED;
+    for (Homey *hub : m_hubs) {
+        if (hub->state() == CONNECTED) {
+            state = CONNECTED;
+            break;
+        }
+        if (hub->state() == CONNECTING) {
+            state = CONNECTING;
+        }
+    }
+    if (state != m_state) {
+        setState(state);
+    }
+}
@@ -0,0 +1,58 @@
+/******************************************************************************
+ *
+ * Copyright (C) 2019-2020 Marton Borzak <hello@martonborzak.com>
+ *
+ * This file is part of the YIO-Remote software project.
+ *
+ * YIO-Remote software is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * YIO-Remote software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with YIO-Remote software. If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *****************************************************************************/
+
+#pragma once
+
+#include <QMap>
+#include <QString>
+#include <QVariant>
+
+#include "homey.h"
+
+// Integration for several Homey hubs, configured with a "hubs" list. Each hub is a Homey connection of its own with
+// its own socket, queues, reconnect backoff and metrics, all on the event loop of the integration's worker thread.
+// Entity IDs are "<hub id>:<deviceId>", commands are routed to the hub by that prefix.
+class HomeyHubs : public Integration {
+    Q_OBJECT
+
+ public:
+    HomeyHubs(const QVariantMap& config, EntitiesInterface* entities, NotificationsInterface* notifications,
+              YioAPIInterface* api, ConfigInterface* configObj, Plugin* plugin);
+
+    void sendCommand(const QString& type, const QString& entityId, int command, const QVariant& param) override;
+
+    // per hub id: see Homey::commandStatistics and Homey::metrics
+    Q_INVOKABLE QVariantMap commandStatistics() const;
+    Q_INVOKABLE QVariantMap metrics() const;
+
+ public slots:
+    void connect() override;
+    void disconnect() override;
+    void enterStandby() override;
+    void leaveStandby() override;
+
+ private slots:
+    void onHubStateChanged();
+
+ private:
+    QMap<QString, Homey*> m_hubs;
+};
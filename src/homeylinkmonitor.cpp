@@ -0,0 +1,75 @@
+/******************************************************************************
+ *
+ * Copyright (C) 2019-2020 Marton Borzak <hello@martonborzak.com>
+ *
+ * This file is part of the YIO-Remote software project.
+ *
+ * YIO-Remote software is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * YIO-Remote software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with YIO-Remote software. If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *****************************************************************************/
+
+#include "homeylinkmonitor.h"
+
+HomeyLinkMonitor::HomeyLinkMonitor(QWebSocket *socket, int interval, int timeout, QObject *parent)
+    : QObject(parent), m_socket(socket) {
+    m_pingTimer = new QTimer(this);
+    m_pingTimer->setInterval(interval);
+
+    m_deadline = new QTimer(this);
+    m_deadline->setSingleShot(true);
+    m_deadline->setInterval(timeout);
+
+    QObject::connect(m_pingTimer, &QTimer::timeout, this, &HomeyLinkMonitor::ping);
+    QObject::connect(m_deadline, &QTimer::timeout, this, &HomeyLinkMonitor::onDeadline);
+    QObject::connect(m_socket, &QWebSocket::pong, this, &HomeyLinkMonitor::onPong);
+}
+
+void HomeyLinkMonitor::start() {
+    m_deadline->stop();
+    if (m_pingTimer->interval() > 0) {
+        m_pingTimer->start();
+    }
+}
+
+void HomeyLinkMonitor::stop() {
+    m_pingTimer->stop();
+    m_deadline->stop();
+}
+
+void HomeyLinkMonitor::ping() {
+    if (m_pingTimer->interval() <= 0 || !m_socket->isValid() || m_deadline->isActive()) {
+        return;
+    }
+    m_socket->ping();
+    m_deadline->start();
+}
+
+void HomeyLinkMonitor::alive() {
+    m_deadline->stop();
+    if (m_pingTimer->isActive()) {
+        m_pingTimer->start();
+    }
+}
+
+void HomeyLinkMonitor::onPong(quint64 elapsedTime, const QByteArray &payload) {
+    Q_UNUSED(payload);
+    m_deadline->stop();
+    emit roundTripTime(static_cast<qint64>(elapsedTime));
+}
+
+void HomeyLinkMonitor::onDeadline() {
+    m_pingTimer->stop();
+    emit dead();
+}
@@ -0,0 +1,60 @@
+/******************************************************************************
+ *
+ * Copyright (C) 2019-2020 Marton Borzak <hello@martonborzak.com>
+ *
+ * This file is part of the YIO-Remote software project.
+ *
+ * YIO-Remote software is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * YIO-Remote software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with YIO-Remote software. If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *****************************************************************************/
+
+#pragma once
+
+#include <QByteArray>
+#include <QObject>
+#include <QTimer>
+#include <QtWebSockets/QWebSocket>
+
+// Detects dead links of an open websocket. Idle links are pinged every 'interval' ms, received frames count as
+// proof of life and postpone the next ping. The link is declared dead if a ping is not answered within 'timeout' ms,
+// e.g. a half-open TCP connection after a Wi-Fi roam.
+class HomeyLinkMonitor : public QObject {
+    Q_OBJECT
+
+ public:
+    HomeyLinkMonitor(QWebSocket* socket, int interval, int timeout, QObject* parent = nullptr);
+
+    void start();
+    void stop();
+
+    // checks the link right away, e.g. after leaving standby. Does nothing if pings are disabled with interval 0.
+    void ping();
+
+    // to be called for every received frame
+    void alive();
+
+ signals:
+    void roundTripTime(qint64 ms);
+    void dead();
+
+ private slots:
+    void onPong(quint64 elapsedTime, const QByteArray& payload);
+    void onDeadline();
+
+ private:
+    QWebSocket* m_socket;
+    QTimer*     m_pingTimer;
+    QTimer*     m_deadline;
+};
@@ -0,0 +1,72 @@
+/******************************************************************************
+ *
+ * Copyright (C) 2019-2020 Marton Borzak <hello@martonborzak.com>
+ *
+ * This file is part of the YIO-Remote software project.
+ *
+ * YIO-Remote software is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * YIO-Remote software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with YIO-Remote software. If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *****************************************************************************/
+
+#include "homeymetrics.h"
+
+void HomeyHistogram::add(qint64 value) {
+    if (value < 0) {
+        value = 0;
+    }
+
+    // bucket 0: 0, bucket n: [2^(n-1), 2^n)
+    int     bucket = 0;
+    quint64 v = static_cast<quint64>(value);
+    while (v != 0 && bucket < BUCKETS - 1) {
+        v >>= 1;
+        bucket++;
+    }
+
+    m_buckets[bucket]++;
+    m_count++;
+    m_sum += value;
+    if (value > m_max) {
+        m_max = value;
+    }
+}
+
+qint64 HomeyHistogram::percentile(int percentile) const {
+    if (m_count == 0) {
+        return 0;
+    }
+
+    quint64 rank = (m_count * static_cast<quint64>(percentile) + 99) / 100;
+    quint64 seen = 0;
+    for (int bucket = 0; bucket < BUCKETS; bucket++) {
+        seen += m_buckets[bucket];
+        if (seen >= rank) {
+            qint64 upper = bucket == 0 ? 0 : (Q_INT64_C(1) << bucket) - 1;
+            return qMin(upper, m_max);
+        }
+    }
+    return m_max;
+}
+
+QVariantMap HomeyHistogram::toVariant() const {
+    QVariantMap map;
+    map.insert("count", m_count);
+    map.insert("avg", m_count == 0 ? 0 : m_sum / static_cast<qint64>(m_count));
+    map.insert("max", m_max);
+    map.insert("p50", percentile(50));
+    map.insert("p95", percentile(95));
+    map.insert("p99", percentile(99));
+    return map;
+}
@@ -0,0 +1,68 @@
+/******************************************************************************
+ *
+ * Copyright (C) 2019-2020 Marton Borzak <hello@martonborzak.com>
+ *
+ * This file is part of the YIO-Remote software project.
+ *
+ * YIO-Remote software is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * YIO-Remote software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with YIO-Remote software. If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *****************************************************************************/
+
+#pragma once
+
+#include <QVariantMap>
+
+#include "homeycapabilities.h"
+
+// Histogram with power of two buckets: constant memory and a few instructions per sample, cheap enough to stay
+// enabled in production. Percentiles are reported as the upper bound of the bucket.
+class HomeyHistogram {
+ public:
+    void add(qint64 value);
+
+    quint64 count() const { return m_count; }
+    qint64  percentile(int percentile) const;
+
+    // count, avg, max, p50, p95, p99
+    QVariantMap toVariant() const;
+
+ private:
+    static const int BUCKETS = 40;
+
+    quint64 m_buckets[BUCKETS] = {};
+    quint64 m_count = 0;
+    qint64  m_sum = 0;
+    qint64  m_max = 0;
+};
+
+// Runtime counters of the Homey integration
+struct HomeyMetrics {
+    // number of Homey::MessageType values, checked in Homey::metrics
+    static const int MESSAGE_TYPES = 8;
+
+    quint64 messages[MESSAGE_TYPES] = {};
+    quint64 bytesIn = 0;
+    quint64 updatesApplied = 0;
+    quint64 updatesSkipped = 0;
+    quint64 attributesSkipped = 0;
+    quint64 entityBatches = 0;
+    quint64 entityMutations = 0;
+    quint64 reconnectAttempts = 0;
+
+    HomeyHistogram parseTime;               // us
+    HomeyHistogram updateTime[KIND_COUNT];  // us, per entity kind
+    HomeyHistogram reconnectTime;           // ms
+    HomeyHistogram pingTime;                // ms
+};
@@ -0,0 +1,102 @@
+/******************************************************************************
+ *
+ * Copyright (C) 2019-2020 Marton Borzak <hello@martonborzak.com>
+ *
+ * This file is part of the YIO-Remote software project.
+ *
+ * YIO-Remote software is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * YIO-Remote software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with YIO-Remote software. If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *****************************************************************************/
+
+#include "homeyoutbox.h"
+
+HomeyOutbox::HomeyOutbox(QWebSocket *socket, int lowWater, int bulkLimit, QObject *parent)
+    : QObject(parent), m_socket(socket), m_lowWater(lowWater), m_bulkLimit(bulkLimit) {
+    QObject::connect(m_socket, &QWebSocket::bytesWritten, this, &HomeyOutbox::drain);
+}
+
+bool HomeyOutbox::send(const QByteArray &message, Priority priority, const QByteArray &key) {
+    if (!m_socket->isValid()) {
+        m_dropped++;
+        return false;
+    }
+
+    if (priority == INTERACTIVE) {
+        write(message, INTERACTIVE);
+        return true;
+    }
+
+    bool replaced = false;
+    if (!key.isEmpty()) {
+        for (Message &queued : m_bulk) {
+            if (queued.key == key) {
+                m_queuedBytes += message.size() - queued.data.size();
+                queued.data = message;
+                m_replaced++;
+                replaced = true;
+                break;
+            }
+        }
+    }
+
+    if (!replaced) {
+        m_bulk.enqueue(Message{key, message});
+        m_queuedBytes += message.size();
+    }
+
+    // drop the oldest messages over the limit, the newest message is always kept
+    while (m_queuedBytes > m_bulkLimit && m_bulk.size() > 1) {
+        m_queuedBytes -= m_bulk.dequeue().data.size();
+        m_dropped++;
+    }
+
+    drain();
+    return true;
+}
+
+void HomeyOutbox::clear() {
+    m_bulk.clear();
+    m_queuedBytes = 0;
+}
+
+QVariantMap HomeyOutbox::statistics() const {
+    QVariantMap map;
+    map.insert("interactive_messages", m_messages[INTERACTIVE]);
+    map.insert("interactive_bytes", m_bytes[INTERACTIVE]);
+    map.insert("bulk_messages", m_messages[BULK]);
+    map.insert("bulk_bytes", m_bytes[BULK]);
+    map.insert("queued_messages", m_bulk.size());
+    map.insert("queued_bytes", m_queuedBytes);
+    map.insert("replaced", m_replaced);
+    map.insert("dropped", m_dropped);
+    return map;
+}
+
+void HomeyOutbox::drain() {
+    // A bulk message is written as a whole, a websocket message can't be split around a command: only start one when
+    // the socket has (almost) caught up. Commands sent while it is transmitted wait for it.
+    while (!m_bulk.isEmpty() && m_socket->isValid() && m_socket->bytesToWrite() < m_lowWater) {
+        Message message = m_bulk.dequeue();
+        m_queuedBytes -= message.data.size();
+        write(message.data, BULK);
+    }
+}
+
+void HomeyOutbox::write(const QByteArray &message, Priority priority) {
+    // QWebSocket only sends text frames from a QString
+    m_socket->sendTextMessage(QString::fromUtf8(message));
+    m_messages[priority]++;
+    m_bytes[priority] += static_cast<quint64>(message.size());
+}
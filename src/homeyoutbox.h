@@ -0,0 +1,78 @@
+/******************************************************************************
+ *
+ * Copyright (C) 2019-2020 Marton Borzak <hello@martonborzak.com>
+ *
+ * This file is part of the YIO-Remote software project.
+ *
+ * YIO-Remote software is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * YIO-Remote software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with YIO-Remote software. If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *****************************************************************************/
+
+#pragma once
+
+#include <QByteArray>
+#include <QObject>
+#include <QQueue>
+#include <QVariantMap>
+#include <QtWebSockets/QWebSocket>
+
+// Outbound message scheduler of the websocket. Interactive messages (commands) are written immediately. Bulk messages
+// (e.g. the getEntities reply) wait until the socket's write backlog is below the low water mark, so a button press
+// never queues up behind queued bulk messages. Queued bulk messages are bounded in memory: a newer message with the
+// same key replaces the queued one, and the oldest messages are dropped once the limit is exceeded.
+// Limit: websocket data messages can't be interleaved, a bulk message is handed to the socket as a whole. A command
+// sent right after that still waits for the whole bulk message to be transmitted, e.g. a large getEntities reply.
+class HomeyOutbox : public QObject {
+    Q_OBJECT
+
+ public:
+    enum Priority { INTERACTIVE, BULK };
+
+    HomeyOutbox(QWebSocket* socket, int lowWater, int bulkLimit, QObject* parent = nullptr);
+
+    // returns false if the message was dropped because the socket is not connected
+    bool send(const QByteArray& message, Priority priority, const QByteArray& key = QByteArray());
+
+    // drops all queued bulk messages, e.g. after the connection is lost
+    void clear();
+
+    quint64 bytesSent() const { return m_bytes[INTERACTIVE] + m_bytes[BULK]; }
+    int     queuedBytes() const { return m_queuedBytes; }
+
+    // messages and bytes sent per priority, queued bulk messages and bytes, replaced and dropped messages
+    QVariantMap statistics() const;
+
+ private slots:
+    void drain();
+
+ private:
+    struct Message {
+        QByteArray key;
+        QByteArray data;
+    };
+
+    void write(const QByteArray& message, Priority priority);
+
+    QWebSocket*     m_socket;
+    int             m_lowWater;
+    int             m_bulkLimit;
+    QQueue<Message> m_bulk;
+    int             m_queuedBytes = 0;
+
+    quint64 m_messages[2] = {};
+    quint64 m_bytes[2] = {};
+    quint64 m_replaced = 0;
+    quint64 m_dropped = 0;
+};
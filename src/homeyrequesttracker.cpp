@@ -0,0 +1,149 @@
+/******************************************************************************
+ *
+ * Copyright (C) 2019-2020 Marton Borzak <hello@martonborzak.com>
+ *
+ * This file is part of the YIO-Remote software project.
+ *
+ * YIO-Remote software is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * YIO-Remote software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with YIO-Remote software. If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *****************************************************************************/
+
+#include "homeyrequesttracker.h"
+
+#include <algorithm>
+
+HomeyRequestTracker::HomeyRequestTracker(int timeout, QObject *parent) : QObject(parent), m_timeout(timeout) {
+    m_timer = new QTimer(this);
+    m_timer->setSingleShot(true);
+    m_clock.start();
+    m_latencies.reserve(LATENCY_SAMPLES);
+
+    QObject::connect(m_timer, &QTimer::timeout, this, &HomeyRequestTracker::onTimeout);
+}
+
+void HomeyRequestTracker::add(int id, const QString &deviceId, const QByteArray &message, bool retry) {
+    qint64 now = m_clock.elapsed();
+    m_inFlight.insert(id, Request{deviceId, message, now, now + m_timeout, retry});
+    if (!m_timer->isActive()) {
+        schedule(now);
+    }
+}
+
+bool HomeyRequestTracker::acknowledge(int id) {
+    QHash<int, Request>::iterator request = m_inFlight.find(id);
+    if (request == m_inFlight.end()) {
+        return false;
+    }
+    complete(request);
+    return true;
+}
+
+bool HomeyRequestTracker::acknowledgeDevice(const QString &deviceId) {
+    // the oldest request of the device is the one most likely causing the event
+    QHash<int, Request>::iterator oldest = m_inFlight.end();
+    for (QHash<int, Request>::iterator it = m_inFlight.begin(); it != m_inFlight.end(); ++it) {
+        if (it.value().deviceId == deviceId && (oldest == m_inFlight.end() || it.key() < oldest.key())) {
+            oldest = it;
+        }
+    }
+
+    if (oldest == m_inFlight.end()) {
+        return false;
+    }
+    complete(oldest);
+    return true;
+}
+
+void HomeyRequestTracker::clear() {
+    m_timer->stop();
+    m_inFlight.clear();
+}
+
+int HomeyRequestTracker::latencyPercentile(int percentile) const {
+    if (m_latencies.isEmpty()) {
+        return -1;
+    }
+
+    QVector<int> sorted = m_latencies;
+    int          index = qBound(0, (sorted.size() * percentile + 99) / 100 - 1, sorted.size() - 1);
+    std::nth_element(sorted.begin(), sorted.begin() + index, sorted.end());
+    return sorted.at(index);
+}
+
+QVariantMap HomeyRequestTracker::statistics() const {
+    QVariantMap map;
+    map.insert("count", m_acknowledged);
+    map.insert("pending", m_inFlight.size());
+    map.insert("retried", m_retried);
+    map.insert("lost", m_lost);
+    map.insert("p50", latencyPercentile(50));
+    map.insert("p95", latencyPercentile(95));
+    map.insert("p99", latencyPercentile(99));
+    return map;
+}
+
+void HomeyRequestTracker::onTimeout() {
+    qint64 now = m_clock.elapsed();
+
+    QHash<int, Request>::iterator it = m_inFlight.begin();
+    while (it != m_inFlight.end()) {
+        Request &request = it.value();
+        if (request.due > now) {
+            ++it;
+        } else if (request.retry) {
+            request.retry = false;
+            request.due = now + m_timeout;
+            m_retried++;
+            emit resend(it.key(), request.message);
+            ++it;
+        } else {
+            QString deviceId = request.deviceId;
+            m_lost++;
+            it = m_inFlight.erase(it);
+            emit lost(deviceId);
+        }
+    }
+
+    schedule(now);
+}
+
+void HomeyRequestTracker::complete(QHash<int, Request>::iterator request) {
+    int latency = static_cast<int>(m_clock.elapsed() - request.value().sent);
+    if (m_latencies.size() < LATENCY_SAMPLES) {
+        m_latencies.append(latency);
+    } else {
+        m_latencies[m_nextLatency] = latency;
+    }
+    m_nextLatency = (m_nextLatency + 1) % LATENCY_SAMPLES;
+    m_acknowledged++;
+
+    m_inFlight.erase(request);
+    if (m_inFlight.isEmpty()) {
+        m_timer->stop();
+    }
+}
+
+void HomeyRequestTracker::schedule(qint64 now) {
+    if (m_inFlight.isEmpty()) {
+        m_timer->stop();
+        return;
+    }
+
+    qint64 due = m_inFlight.constBegin().value().due;
+    for (const Request &request : m_inFlight) {
+        due = qMin(due, request.due);
+    }
+    m_timer->start(static_cast<int>(qMax(Q_INT64_C(0), due - now)));
+}
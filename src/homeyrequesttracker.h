@@ -0,0 +1,93 @@
+/******************************************************************************
+ *
+ * Copyright (C) 2019-2020 Marton Borzak <hello@martonborzak.com>
+ *
+ * This file is part of the YIO-Remote software project.
+ *
+ * YIO-Remote software is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * YIO-Remote software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with YIO-Remote software. If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *****************************************************************************/
+
+#pragma once
+
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QObject>
+#include <QString>
+#include <QTimer>
+#include <QVariantMap>
+#include <QVector>
+
+// Tracks the commands sent to the Homey app until they are acknowledged, either by a result message with the same
+// request id or by the next event of the device. Unacknowledged commands are retried once if 'retry' is set and
+// reported as lost after the timeout. Round-trip times of acknowledged commands are kept for latency percentiles.
+class HomeyRequestTracker : public QObject {
+    Q_OBJECT
+
+ public:
+    explicit HomeyRequestTracker(int timeout, QObject* parent = nullptr);
+
+    int  nextId() { return ++m_lastId; }
+    void add(int id, const QString& deviceId, const QByteArray& message, bool retry);
+
+    // returns false if the request is not in flight (anymore)
+    bool acknowledge(int id);
+    bool acknowledgeDevice(const QString& deviceId);
+
+    // forgets all requests in flight, e.g. after the connection is lost
+    void clear();
+
+    int  inFlight() const { return m_inFlight.size(); }
+    int  latencyPercentile(int percentile) const;
+
+    // count, pending, retried, lost and p50 / p95 / p99 round-trip time in ms
+    QVariantMap statistics() const;
+
+ signals:
+    void resend(int id, const QByteArray& message);
+    void lost(const QString& deviceId);
+
+ private slots:
+    void onTimeout();
+
+ private:
+    struct Request {
+        QString    deviceId;
+        QByteArray message;
+        qint64     sent;
+        qint64     due;
+        bool       retry;
+    };
+
+    void complete(QHash<int, Request>::iterator request);
+    void schedule(qint64 now);
+
+    static const int LATENCY_SAMPLES = 256;
+
+    int                 m_timeout;
+    int                 m_lastId = 0;
+    QTimer*             m_timer;
+    QElapsedTimer       m_clock;
+    QHash<int, Request> m_inFlight;
+
+    // ring buffer of the last round-trip times in ms
+    QVector<int> m_latencies;
+    int          m_nextLatency = 0;
+
+    int m_acknowledged = 0;
+    int m_retried = 0;
+    int m_lost = 0;
+};
@@ -0,0 +1,362 @@
+/******************************************************************************
+ *
+ * Copyright (C) 2019-2020 Marton Borzak <hello@martonborzak.com>
+ *
+ * This file is part of the YIO-Remote software project.
+ *
+ * YIO-Remote software is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * YIO-Remote software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with YIO-Remote software. If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *****************************************************************************/
+
+#include "homeyservicebrowser.h"
+
+#include <QPair>
+#include <QStringList>
+#include <QVector>
+
+// queries for services without cached records are repeated at this interval in ms
+static const int BROWSE_INTERVAL = 60000;
+
+// lower bound for the refresh interval in ms
+static const int MIN_REFRESH_INTERVAL = 1000;
+
+// minimum interval in ms between two identical questions (RFC 6762 5.2)
+static const int QUERY_INTERVAL = 1000;
+
+static quint16 readUInt16(const QByteArray &packet, int offset) {
+    return static_cast<quint16>((static_cast<quint8>(packet.at(offset)) << 8) |
+                                static_cast<quint8>(packet.at(offset + 1)));
+}
+
+static quint32 readUInt32(const QByteArray &packet, int offset) {
+    return (static_cast<quint32>(readUInt16(packet, offset)) << 16) | readUInt16(packet, offset + 2);
+}
+
+HomeyServiceBrowser::HomeyServiceBrowser(const QString &service, const QHostAddress &address, quint16 port,
+                                         QObject *parent)
+    : QObject(parent), m_service(service), m_address(address), m_port(port) {
+    m_socket = new QUdpSocket(this);
+
+    m_refreshTimer = new QTimer(this);
+    m_refreshTimer->setSingleShot(true);
+
+    m_clock.start();
+
+    QObject::connect(m_socket, &QUdpSocket::readyRead, this, &HomeyServiceBrowser::onReadyRead);
+    QObject::connect(m_refreshTimer, &QTimer::timeout, this, &HomeyServiceBrowser::onRefresh);
+}
+
+bool HomeyServiceBrowser::start() {
+    if (m_socket->state() != QAbstractSocket::BoundState) {
+        // Shares port 5353 with a system mDNS daemon. If that's not possible, responders answer queries from another
+        // port by unicast (legacy unicast, RFC 6762 6.7).
+        bool multicast = m_address.isMulticast() &&
+                         m_socket->bind(QHostAddress::AnyIPv4, m_port,
+                                        QUdpSocket::ShareAddress | QUdpSocket::ReuseAddressHint) &&
+                         m_socket->joinMulticastGroup(m_address);
+        if (!multicast) {
+            m_socket->close();
+            if (!m_socket->bind(QHostAddress::AnyIPv4, 0)) {
+                return false;
+            }
+        }
+    }
+
+    query();
+    return true;
+}
+
+void HomeyServiceBrowser::stop() {
+    m_refreshTimer->stop();
+    m_socket->close();
+    m_queries.clear();
+}
+
+void HomeyServiceBrowser::query() {
+    sendQuery(m_service, TYPE_PTR);
+    scheduleRefresh();
+}
+
+void HomeyServiceBrowser::onRefresh() {
+    qint64 now = m_clock.elapsed();
+
+    // forget expired records, query the ones about to expire
+    for (QHash<QString, Service>::iterator it = m_services.begin(); it != m_services.end();) {
+        if (it.value().expires <= now) {
+            m_endpoints.remove(it.key());
+            it = m_services.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    for (QHash<QString, Address>::iterator it = m_addresses.begin(); it != m_addresses.end();) {
+        if (it.value().expires <= now) {
+            it = m_addresses.erase(it);
+        } else {
+            sendQuery(it.key(), TYPE_A);
+            ++it;
+        }
+    }
+    for (QHash<QString, qint64>::iterator it = m_queries.begin(); it != m_queries.end();) {
+        if (now - it.value() >= QUERY_INTERVAL) {
+            it = m_queries.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    // answered with the SRV and A records of the instances as well, expired records are queried again
+    sendQuery(m_service, TYPE_PTR);
+    resolveEndpoints();
+    scheduleRefresh();
+}
+
+void HomeyServiceBrowser::scheduleRefresh() {
+    if (m_socket->state() != QAbstractSocket::BoundState) {
+        return;
+    }
+
+    // 80% of the shortest remaining TTL
+    qint64 now = m_clock.elapsed();
+    qint64 interval = BROWSE_INTERVAL;
+    for (const Service &service : m_services) {
+        interval = qMin(interval, (service.expires - now) * 4 / 5);
+    }
+    for (const Address &address : m_addresses) {
+        interval = qMin(interval, (address.expires - now) * 4 / 5);
+    }
+    interval = qMax(static_cast<qint64>(MIN_REFRESH_INTERVAL), interval);
+
+    // an earlier deadline stays: restarting it on every response would postpone the refresh forever on a busy network
+    if (m_refreshTimer->isActive() && m_refreshTimer->remainingTime() <= interval) {
+        return;
+    }
+    m_refreshTimer->start(static_cast<int>(interval));
+}
+
+void HomeyServiceBrowser::sendQuery(const QString &name, RecordType type) {
+    // the same question at most once per QUERY_INTERVAL, whatever triggers it
+    qint64                           now = m_clock.elapsed();
+    QString                          key = name.toLower() + QLatin1Char('/') + QString::number(type);
+    QHash<QString, qint64>::iterator last = m_queries.find(key);
+    if (last != m_queries.end() && now - last.value() < QUERY_INTERVAL) {
+        return;
+    }
+    m_queries.insert(key, now);
+
+    // header: id 0, standard query, one question
+    QByteArray packet(12, '\0');
+    packet[5] = 1;
+
+    for (const QString &label : name.split(QLatin1Char('.'))) {
+        QByteArray utf8 = label.toUtf8().left(63);
+        if (!utf8.isEmpty()) {
+            packet.append(static_cast<char>(utf8.size())).append(utf8);
+        }
+    }
+    packet.append('\0');
+    packet.append(static_cast<char>(type >> 8)).append(static_cast<char>(type & 0xFF));
+    packet.append('\0').append('\x01');  // class IN
+
+    m_socket->writeDatagram(packet, m_address, m_port);
+}
+
+void HomeyServiceBrowser::onReadyRead() {
+    // Only responses changing the cached records lead to follow-up queries. Unrelated mDNS traffic and our own
+    // queries looped back on the multicast group must not trigger queries of their own.
+    bool changed = false;
+    while (m_socket->hasPendingDatagrams()) {
+        QByteArray packet;
+        packet.resize(static_cast<int>(m_socket->pendingDatagramSize()));
+        if (m_socket->readDatagram(packet.data(), packet.size()) < 0) {
+            break;
+        }
+        changed |= parse(packet);
+    }
+    if (changed) {
+        resolveEndpoints();
+        scheduleRefresh();
+    }
+}
+
+bool HomeyServiceBrowser::parse(const QByteArray &packet) {
+    // responses only, skip our own and other queries
+    if (packet.size() < 12 || !(static_cast<quint8>(packet.at(2)) & 0x80)) {
+        return false;
+    }
+
+    int questions = readUInt16(packet, 4);
+    int records = readUInt16(packet, 6) + readUInt16(packet, 8) + readUInt16(packet, 10);
+    int offset = 12;
+
+    QString name;
+    for (int i = 0; i < questions; i++) {
+        if (!readName(packet, &offset, &name)) {
+            return false;
+        }
+        offset += 4;
+    }
+
+    // A records are applied after the SRV records of the same response, only for the targets of the service
+    bool                             changed = false;
+    QVector<QPair<QString, Address>> addresses;
+    qint64                           now = m_clock.elapsed();
+    for (int i = 0; i < records; i++) {
+        if (!readName(packet, &offset, &name) || offset + 10 > packet.size()) {
+            break;
+        }
+        quint16 type = readUInt16(packet, offset);
+        quint32 ttl = readUInt32(packet, offset + 4);
+        int     length = readUInt16(packet, offset + 8);
+        int     data = offset + 10;
+        offset = data + length;
+        if (offset > packet.size()) {
+            break;
+        }
+
+        // a TTL of 0 announces the removal of the record
+        qint64 expires = now + static_cast<qint64>(ttl) * 1000;
+
+        if (type == TYPE_PTR && name.compare(m_service, Qt::CaseInsensitive) == 0) {
+            QString instance;
+            int     position = data;
+            if (!readName(packet, &position, &instance)) {
+                continue;
+            }
+            if (ttl == 0) {
+                changed |= m_services.remove(instance) > 0;
+                m_endpoints.remove(instance);
+            } else if (!m_services.contains(instance)) {
+                // resolved with the SRV record, usually in the same response
+                Service service;
+                service.expires = expires;
+                m_services.insert(instance, service);
+                changed = true;
+            }
+        } else if (type == TYPE_SRV && length > 6 && name.endsWith(m_service, Qt::CaseInsensitive)) {
+            Service service;
+            int     position = data + 6;
+            service.port = readUInt16(packet, data + 4);
+            service.expires = expires;
+            if (!readName(packet, &position, &service.target)) {
+                continue;
+            }
+            QHash<QString, Service>::iterator known = m_services.find(name);
+            if (ttl == 0) {
+                if (known != m_services.end()) {
+                    m_services.erase(known);
+                    m_endpoints.remove(name);
+                    changed = true;
+                }
+            } else if (known == m_services.end() || known.value().target != service.target ||
+                       known.value().port != service.port) {
+                m_services.insert(name, service);
+                changed = true;
+            } else {
+                known.value().expires = expires;
+            }
+        } else if (type == TYPE_A && length == 4) {
+            // expires 0: removed
+            Address address{QHostAddress(readUInt32(packet, data)), ttl > 0 ? expires : 0};
+            addresses.append(qMakePair(name.toLower(), address));
+        }
+    }
+
+    for (const QPair<QString, Address> &record : addresses) {
+        if (!isTarget(record.first)) {
+            continue;
+        }
+        QHash<QString, Address>::iterator known = m_addresses.find(record.first);
+        if (record.second.expires == 0) {
+            if (known != m_addresses.end()) {
+                m_addresses.erase(known);
+                changed = true;
+            }
+        } else if (known == m_addresses.end() || known.value().address != record.second.address) {
+            m_addresses.insert(record.first, record.second);
+            changed = true;
+        } else {
+            known.value().expires = record.second.expires;
+        }
+    }
+    return changed;
+}
+
+bool HomeyServiceBrowser::isTarget(const QString &host) const {
+    for (const Service &service : m_services) {
+        if (service.target.compare(host, Qt::CaseInsensitive) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void HomeyServiceBrowser::resolveEndpoints() {
+    for (QHash<QString, Service>::const_iterator it = m_services.constBegin(); it != m_services.constEnd(); ++it) {
+        const Service &service = it.value();
+        if (service.target.isEmpty()) {
+            // PTR without SRV record
+            sendQuery(it.key(), TYPE_SRV);
+            continue;
+        }
+
+        QHash<QString, Address>::const_iterator address = m_addresses.constFind(service.target.toLower());
+        if (address == m_addresses.constEnd()) {
+            sendQuery(service.target, TYPE_A);
+            continue;
+        }
+
+        QString endpoint = QString("%1:%2").arg(address.value().address.toString()).arg(service.port);
+        if (m_endpoints.value(it.key()) != endpoint) {
+            m_endpoints.insert(it.key(), endpoint);
+            emit endpointFound(service.target, address.value().address, service.port);
+        }
+    }
+}
+
+bool HomeyServiceBrowser::readName(const QByteArray &packet, int *offset, QString *name) {
+    QStringList labels;
+    int         position = *offset;
+    int         end = -1;  // end of the name in the record if compressed
+
+    // bounded number of compression pointers: malformed packets must not loop
+    for (int jumps = 0; jumps < 16 && position < packet.size();) {
+        quint8 length = static_cast<quint8>(packet.at(position));
+        if (length == 0) {
+            *offset = end >= 0 ? end : position + 1;
+            *name = labels.join(QLatin1Char('.'));
+            return true;
+        }
+
+        if ((length & 0xC0) == 0xC0) {
+            if (position + 1 >= packet.size()) {
+                return false;
+            }
+            if (end < 0) {
+                end = position + 2;
+            }
+            position = ((length & 0x3F) << 8) | static_cast<quint8>(packet.at(position + 1));
+            jumps++;
+            continue;
+        }
+
+        if (position + 1 + length > packet.size()) {
+            return false;
+        }
+        labels.append(QString::fromUtf8(packet.constData() + position + 1, length));
+        position += 1 + length;
+    }
+    return false;
+}
@@ -0,0 +1,90 @@
+/******************************************************************************
+ *
+ * Copyright (C) 2019-2020 Marton Borzak <hello@martonborzak.com>
+ *
+ * This file is part of the YIO-Remote software project.
+ *
+ * YIO-Remote software is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * YIO-Remote software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with YIO-Remote software. If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *****************************************************************************/
+
+#pragma once
+
+#include <QElapsedTimer>
+#include <QHash>
+#include <QHostAddress>
+#include <QObject>
+#include <QString>
+#include <QTimer>
+#include <QtNetwork/QUdpSocket>
+
+// Minimal mDNS (DNS-SD) browser for one service type, e.g. "_yio2homeyapi._tcp.local". Resolved endpoints (SRV target
+// host, IPv4 address and port) are cached with their TTL and refreshed in the background at 80% of the TTL.
+// With a multicast group (224.0.0.251:5353) the browser also receives announcements of the responders. Any other
+// address is queried by unicast, e.g. a local stand-in responder.
+class HomeyServiceBrowser : public QObject {
+    Q_OBJECT
+
+ public:
+    HomeyServiceBrowser(const QString& service, const QHostAddress& address, quint16 port, QObject* parent = nullptr);
+
+    bool start();
+    void stop();
+
+    // browses for the service right away
+    void query();
+
+ signals:
+    // new or changed endpoint, 'host' is the SRV target without the trailing dot
+    void endpointFound(const QString& host, const QHostAddress& address, quint16 port);
+
+ private slots:
+    void onReadyRead();
+    void onRefresh();
+
+ private:
+    enum RecordType : quint16 { TYPE_A = 1, TYPE_PTR = 12, TYPE_SRV = 33 };
+
+    struct Service {
+        QString target;
+        quint16 port = 0;
+        qint64  expires = 0;
+    };
+
+    struct Address {
+        QHostAddress address;
+        qint64       expires = 0;
+    };
+
+    void sendQuery(const QString& name, RecordType type);
+    bool parse(const QByteArray& packet);
+    bool isTarget(const QString& host) const;
+    void resolveEndpoints();
+    void scheduleRefresh();
+
+    static bool readName(const QByteArray& packet, int* offset, QString* name);
+
+    QString       m_service;
+    QHostAddress  m_address;
+    quint16       m_port;
+    QUdpSocket*   m_socket;
+    QTimer*       m_refreshTimer;
+    QElapsedTimer m_clock;
+
+    QHash<QString, Service> m_services;   // instance name
+    QHash<QString, Address> m_addresses;  // lower case host name
+    QHash<QString, QString> m_endpoints;  // instance name to the last reported "address:port"
+    QHash<QString, qint64>  m_queries;    // lower case name and type to the time the question was last sent
+};
@@ -0,0 +1,94 @@
+/******************************************************************************
+ *
+ * Copyright (C) 2019-2020 Marton Borzak <hello@martonborzak.com>
+ *
+ * This file is part of the YIO-Remote software project.
+ *
+ * YIO-Remote software is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * YIO-Remote software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with YIO-Remote software. If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *****************************************************************************/
+
+#include "homeysnapshot.h"
+
+#include <QDataStream>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+
+HomeySnapshot::HomeySnapshot(const QString &fileName) : m_fileName(fileName) {}
+
+bool HomeySnapshot::load(QVariantList *entities, QHash<QString, HomeyStateUpdate> *states) const {
+    QFile file(m_fileName);
+    if (m_fileName.isEmpty() || !file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    QDataStream in(&file);
+    in.setVersion(QDataStream::Qt_5_6);
+
+    quint32 magic;
+    quint16 version;
+    in >> magic >> version;
+    if (magic != MAGIC || version != VERSION) {
+        return false;
+    }
+
+    QVariantList loadedEntities;
+    quint32      count;
+    in >> loadedEntities >> count;
+
+    QHash<QString, HomeyStateUpdate> loadedStates;
+    loadedStates.reserve(static_cast<int>(qMin(count, 10000u)));
+    for (quint32 i = 0; i < count && in.status() == QDataStream::Ok; i++) {
+        HomeyStateUpdate state;
+        in >> state;
+        loadedStates.insert(state.entityId, state);
+    }
+
+    if (in.status() != QDataStream::Ok) {
+        return false;
+    }
+
+    entities->swap(loadedEntities);
+    states->swap(loadedStates);
+    return true;
+}
+
+bool HomeySnapshot::save(const QVariantList &entities, const QHash<QString, HomeyStateUpdate> &states) const {
+    if (m_fileName.isEmpty() || !QDir().mkpath(QFileInfo(m_fileName).absolutePath())) {
+        return false;
+    }
+
+    // written to a temporary file first: an interrupted write never corrupts the previous snapshot
+    QSaveFile file(m_fileName);
+    if (!file.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+
+    QDataStream out(&file);
+    out.setVersion(QDataStream::Qt_5_6);
+
+    out << MAGIC << VERSION << entities << static_cast<quint32>(states.size());
+    for (const HomeyStateUpdate &state : states) {
+        out << state;
+    }
+
+    if (out.status() != QDataStream::Ok) {
+        file.cancelWriting();
+        return false;
+    }
+    return file.commit();
+}
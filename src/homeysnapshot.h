@@ -0,0 +1,47 @@
+/******************************************************************************
+ *
+ * Copyright (C) 2019-2020 Marton Borzak <hello@martonborzak.com>
+ *
+ * This file is part of the YIO-Remote software project.
+ *
+ * YIO-Remote software is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * YIO-Remote software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with YIO-Remote software. If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *****************************************************************************/
+
+#pragma once
+
+#include <QHash>
+#include <QString>
+#include <QVariantList>
+
+#include "homeystateupdate.h"
+
+// Versioned on-disk snapshot of the Homey entity catalog and the last known device states. Used to populate the
+// entities at startup before the Homey app answers. A snapshot written by a different version is ignored.
+class HomeySnapshot {
+ public:
+    explicit HomeySnapshot(const QString& fileName = QString());
+
+    const QString& fileName() const { return m_fileName; }
+
+    bool load(QVariantList* entities, QHash<QString, HomeyStateUpdate>* states) const;
+    bool save(const QVariantList& entities, const QHash<QString, HomeyStateUpdate>& states) const;
+
+ private:
+    static const quint32 MAGIC = 0x484d5953;  // "HMYS"
+    static const quint16 VERSION = 3;
+
+    QString m_fileName;
+};
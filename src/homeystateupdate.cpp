@@ -0,0 +1,283 @@
+/******************************************************************************
+ *
+ * Copyright (C) 2019-2020 Marton Borzak <hello@martonborzak.com>
+ *
+ * This file is part of the YIO-Remote software project.
+ *
+ * YIO-Remote software is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * YIO-Remote software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with YIO-Remote software. If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *****************************************************************************/
+
+#include "homeystateupdate.h"
+
+#include <QJsonArray>
+#include <QJsonValue>
+
+HomeyStateUpdate HomeyStateUpdate::fromJson(const QJsonObject &data) {
+    HomeyStateUpdate update;
+    update.entityId = data.value(QLatin1String("entity_id")).toString();
+
+    QJsonValue revision = data.value(QLatin1String("revision"));
+    if (revision.isDouble()) {
+        update.revision = static_cast<qint64>(revision.toDouble());
+    }
+
+    QJsonObject::const_iterator it = data.constFind(QLatin1String("onoff"));
+    if (it != data.constEnd()) {
+        update.present |= ONOFF;
+        update.onoff = it.value().toBool();
+    }
+
+    it = data.constFind(QLatin1String("dim"));
+    if (it != data.constEnd()) {
+        update.present |= DIM;
+        update.dim = it.value().toDouble();
+    }
+
+    it = data.constFind(QLatin1String("volume_set"));
+    if (it != data.constEnd()) {
+        update.present |= VOLUME_SET;
+        update.volume = it.value().toDouble();
+    }
+
+    it = data.constFind(QLatin1String("speaker_playing"));
+    if (it != data.constEnd()) {
+        update.present |= SPEAKER_PLAYING;
+        update.playing = it.value().toBool();
+    }
+
+    it = data.constFind(QLatin1String("speaker_track"));
+    if (it != data.constEnd()) {
+        update.present |= SPEAKER_TRACK;
+        update.track = it.value().toString();
+    }
+
+    it = data.constFind(QLatin1String("speaker_artist"));
+    if (it != data.constEnd()) {
+        update.present |= SPEAKER_ARTIST;
+        update.artist = it.value().toString();
+    }
+
+    it = data.constFind(QLatin1String("album_art"));
+    if (it != data.constEnd()) {
+        update.present |= ALBUM_ART;
+        update.albumArt = it.value().toString();
+    }
+
+    // album art of the next track in the queue, if known
+    it = data.constFind(QLatin1String("next_album_art"));
+    if (it != data.constEnd()) {
+        update.present |= NEXT_ALBUM_ART;
+        update.nextAlbumArt = it.value().toString();
+    }
+
+    it = data.constFind(QLatin1String("windowcoverings_set"));
+    if (it != data.constEnd()) {
+        update.present |= WINDOWCOVERINGS_SET;
+        update.position = it.value().toDouble();
+    }
+
+    it = data.constFind(QLatin1String("windowcoverings_closed"));
+    if (it != data.constEnd()) {
+        update.present |= WINDOWCOVERINGS_CLOSED;
+        // sent as string by some Homey apps, like our commands
+        update.closed = it.value().isString() ? it.value().toString() == QLatin1String("true") : it.value().toBool();
+    }
+
+    it = data.constFind(QLatin1String("target_temperature"));
+    if (it != data.constEnd()) {
+        update.present |= TARGET_TEMPERATURE;
+        update.targetTemperature = it.value().toDouble();
+    }
+
+    it = data.constFind(QLatin1String("measure_temperature"));
+    if (it != data.constEnd()) {
+        update.present |= MEASURE_TEMPERATURE;
+        update.measureTemperature = it.value().toDouble();
+    }
+
+    // nested attributes object
+    it = data.constFind(QLatin1String("attributes"));
+    if (it != data.constEnd() && it.value().isObject()) {
+        QJsonObject attributes = it.value().toObject();
+
+        QJsonObject::const_iterator attr = attributes.constFind(QLatin1String("rgb_color"));
+        if (attr != attributes.constEnd()) {
+            update.present |= RGB_COLOR;
+            QJsonArray color = attr.value().toArray();
+            for (int i = 0; i < 3 && i < color.size(); i++) {
+                update.rgb[i] = qRound(color.at(i).toDouble());
+            }
+        }
+
+        attr = attributes.constFind(QLatin1String("media_content_type"));
+        if (attr != attributes.constEnd()) {
+            update.present |= MEDIA_CONTENT_TYPE;
+            update.mediaContentType = attr.value().toString();
+        }
+    }
+
+    return update;
+}
+
+const char *HomeyStateUpdate::capabilityName(int capabilityBit) {
+    // same order as the Capability bits
+    static const char *names[CAPABILITY_COUNT] = {"onoff",
+                                                  "dim",
+                                                  "rgb_color",
+                                                  "volume_set",
+                                                  "speaker_playing",
+                                                  "speaker_track",
+                                                  "speaker_artist",
+                                                  "album_art",
+                                                  "media_content_type",
+                                                  "windowcoverings_set",
+                                                  "windowcoverings_closed",
+                                                  "target_temperature",
+                                                  "measure_temperature",
+                                                  "next_album_art"};
+
+    if (capabilityBit < 0 || capabilityBit >= CAPABILITY_COUNT) {
+        return nullptr;
+    }
+    return names[capabilityBit];
+}
+
+QString HomeyStateUpdate::colorName() const {
+    static const char hex[] = "0123456789ABCDEF";
+
+    QChar name[7];
+    name[0] = QLatin1Char('#');
+    for (int i = 0; i < 3; i++) {
+        int value = qBound(0, rgb[i], 255);
+        name[1 + i * 2] = QLatin1Char(hex[value >> 4]);
+        name[2 + i * 2] = QLatin1Char(hex[value & 0xF]);
+    }
+    return QString(name, 7);
+}
+
+bool HomeyStateUpdate::flag(Capability capability) const {
+    switch (capability) {
+        case ONOFF:
+            return onoff;
+        case SPEAKER_PLAYING:
+            return playing;
+        case WINDOWCOVERINGS_CLOSED:
+            return closed;
+        default:
+            return false;
+    }
+}
+
+double HomeyStateUpdate::number(Capability capability) const {
+    switch (capability) {
+        case DIM:
+            return dim;
+        case VOLUME_SET:
+            return volume;
+        case WINDOWCOVERINGS_SET:
+            return position;
+        case TARGET_TEMPERATURE:
+            return targetTemperature;
+        case MEASURE_TEMPERATURE:
+            return measureTemperature;
+        default:
+            return 0;
+    }
+}
+
+QString HomeyStateUpdate::text(Capability capability) const {
+    switch (capability) {
+        case SPEAKER_TRACK:
+            return track;
+        case SPEAKER_ARTIST:
+            return artist;
+        case ALBUM_ART:
+            return albumArt;
+        case MEDIA_CONTENT_TYPE:
+            return mediaContentType;
+        case NEXT_ALBUM_ART:
+            return nextAlbumArt;
+        case RGB_COLOR:
+            return colorName();
+        default:
+            return QString();
+    }
+}
+
+void HomeyStateUpdate::merge(const HomeyStateUpdate &newer) {
+    if (newer.has(ONOFF)) {
+        onoff = newer.onoff;
+    }
+    if (newer.has(DIM)) {
+        dim = newer.dim;
+    }
+    if (newer.has(RGB_COLOR)) {
+        rgb[0] = newer.rgb[0];
+        rgb[1] = newer.rgb[1];
+        rgb[2] = newer.rgb[2];
+    }
+    if (newer.has(VOLUME_SET)) {
+        volume = newer.volume;
+    }
+    if (newer.has(SPEAKER_PLAYING)) {
+        playing = newer.playing;
+    }
+    if (newer.has(SPEAKER_TRACK)) {
+        track = newer.track;
+    }
+    if (newer.has(SPEAKER_ARTIST)) {
+        artist = newer.artist;
+    }
+    if (newer.has(ALBUM_ART)) {
+        albumArt = newer.albumArt;
+    }
+    if (newer.has(MEDIA_CONTENT_TYPE)) {
+        mediaContentType = newer.mediaContentType;
+    }
+    if (newer.has(WINDOWCOVERINGS_SET)) {
+        position = newer.position;
+    }
+    if (newer.has(WINDOWCOVERINGS_CLOSED)) {
+        closed = newer.closed;
+    }
+    if (newer.has(TARGET_TEMPERATURE)) {
+        targetTemperature = newer.targetTemperature;
+    }
+    if (newer.has(MEASURE_TEMPERATURE)) {
+        measureTemperature = newer.measureTemperature;
+    }
+    if (newer.has(NEXT_ALBUM_ART)) {
+        nextAlbumArt = newer.nextAlbumArt;
+    }
+    present |= newer.present;
+    revision = qMax(revision, newer.revision);
+}
+
+QDataStream &operator<<(QDataStream &out, const HomeyStateUpdate &update) {
+    out << update.entityId << update.present << update.revision << update.onoff << update.dim << update.rgb[0]
+        << update.rgb[1] << update.rgb[2] << update.volume << update.playing << update.track << update.artist
+        << update.albumArt << update.mediaContentType << update.position << update.closed << update.targetTemperature
+        << update.measureTemperature << update.nextAlbumArt;
+    return out;
+}
+
+QDataStream &operator>>(QDataStream &in, HomeyStateUpdate &update) {
+    in >> update.entityId >> update.present >> update.revision >> update.onoff >> update.dim >> update.rgb[0] >>
+        update.rgb[1] >> update.rgb[2] >> update.volume >> update.playing >> update.track >> update.artist >>
+        update.albumArt >> update.mediaContentType >> update.position >> update.closed >> update.targetTemperature >>
+        update.measureTemperature >> update.nextAlbumArt;
+    return in;
+}
@@ -0,0 +1,89 @@
+/******************************************************************************
+ *
+ * Copyright (C) 2019-2020 Marton Borzak <hello@martonborzak.com>
+ *
+ * This file is part of the YIO-Remote software project.
+ *
+ * YIO-Remote software is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * YIO-Remote software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with YIO-Remote software. If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *****************************************************************************/
+
+#pragma once
+
+#include <QDataStream>
+#include <QJsonObject>
+#include <QString>
+
+// Typed capability values of one Homey device, decoded directly from the "data" object of a sendStates or event
+// message. Only the capabilities flagged in 'present' carry a value.
+struct HomeyStateUpdate {
+    enum Capability : quint32 {
+        ONOFF = 1u << 0,
+        DIM = 1u << 1,
+        RGB_COLOR = 1u << 2,
+        VOLUME_SET = 1u << 3,
+        SPEAKER_PLAYING = 1u << 4,
+        SPEAKER_TRACK = 1u << 5,
+        SPEAKER_ARTIST = 1u << 6,
+        ALBUM_ART = 1u << 7,
+        MEDIA_CONTENT_TYPE = 1u << 8,
+        WINDOWCOVERINGS_SET = 1u << 9,
+        WINDOWCOVERINGS_CLOSED = 1u << 10,
+        TARGET_TEMPERATURE = 1u << 11,
+        MEASURE_TEMPERATURE = 1u << 12,
+        NEXT_ALBUM_ART = 1u << 13
+    };
+    static const int CAPABILITY_COUNT = 14;
+
+    QString entityId;
+    quint32 present = 0;
+    qint64  revision = -1;  // state revision of the device if provided by the Homey app
+
+    bool    onoff = false;
+    double  dim = 0;
+    int     rgb[3] = {0, 0, 0};
+    double  volume = 0;
+    bool    playing = false;
+    QString track;
+    QString artist;
+    QString albumArt;
+    QString mediaContentType;
+    double  position = 0;
+    bool    closed = false;
+    double  targetTemperature = 0;
+    double  measureTemperature = 0;
+    QString nextAlbumArt;
+
+    bool has(Capability capability) const { return (present & capability) != 0; }
+
+    // value of a capability by type, default value if the capability has a different type
+    bool    flag(Capability capability) const;
+    double  number(Capability capability) const;
+    QString text(Capability capability) const;
+
+    // rgb color in #RRGGBB notation
+    QString colorName() const;
+
+    // Merges a newer update of the same device into this one: capabilities present in 'newer' overwrite ours.
+    void merge(const HomeyStateUpdate& newer);
+
+    // Homey capability name of a capability bit, as in the state data
+    static const char* capabilityName(int capabilityBit);
+
+    static HomeyStateUpdate fromJson(const QJsonObject& data);
+};
+
+QDataStream& operator<<(QDataStream& out, const HomeyStateUpdate& update);
+QDataStream& operator>>(QDataStream& in, HomeyStateUpdate& update);
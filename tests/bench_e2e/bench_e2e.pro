@@ -0,0 +1,15 @@
+# End-to-end benchmark of the integration against a mock of the YIO app on Homey, fully offline:
+# events/s, update latency, command round-trip time and peak memory, e.g.
+#   bench_e2e --devices 1000 --rate 5000 --command-rate 20 --duration 30
+TARGET = bench_e2e
+
+include(../common.pri)
+
+# run with options, not as part of 'make check'
+CONFIG -= testcase
+
+HEADERS += e2ebenchmark.h \
+           mockhomeyserver.h
+SOURCES += e2ebenchmark.cpp \
+           main.cpp \
+           mockhomeyserver.cpp
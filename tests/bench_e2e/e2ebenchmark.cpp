@@ -0,0 +1,313 @@
+/******************************************************************************
+ *
+ * Copyright (C) 2019-2020 Marton Borzak <hello@martonborzak.com>
+ *
+ * This file is part of the YIO-Remote software project.
+ *
+ * YIO-Remote software is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * YIO-Remote software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with YIO-Remote software. If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *****************************************************************************/
+
+#include "e2ebenchmark.h"
+
+#include <algorithm>
+
+#include <QCoreApplication>
+#include <QJsonDocument>
+#include <QTextStream>
+#include <QtDebug>
+
+#ifdef Q_OS_UNIX
+#include <sys/resource.h>
+#endif
+
+#include "yio-interface/entities/lightinterface.h"
+
+// time in ms for registering the entities and for syncing their states
+static const int SETUP_TIMEOUT = 60000;
+
+// time in ms after the load for the last events and command results
+static const int DRAIN_TIME = 1000;
+
+E2eBenchmark::E2eBenchmark(const Options &options, QObject *parent)
+    : QObject(parent), m_options(options), m_entities(new StubEntities(this)), m_api(m_entities) {
+    m_plugin = new HomeyPlugin();
+
+    m_progressTimer = new QTimer(this);
+    m_progressTimer->setInterval(10);
+    QObject::connect(m_progressTimer, &QTimer::timeout, this, &E2eBenchmark::onProgress);
+
+    m_commandTimer = new QTimer(this);
+    m_commandTimer->setTimerType(Qt::PreciseTimer);
+    if (m_options.commandRate > 0) {
+        m_commandTimer->setInterval(qMax(1, 1000 / m_options.commandRate));
+    }
+    QObject::connect(m_commandTimer, &QTimer::timeout, this, &E2eBenchmark::onCommandTimeout);
+
+    QObject::connect(m_entities, &StubEntities::entityChanged, this, &E2eBenchmark::onEntityChanged);
+}
+
+E2eBenchmark::~E2eBenchmark() {
+    shutdown();
+    delete m_plugin;
+}
+
+void E2eBenchmark::start() {
+    if (!m_cacheDir.isValid()) {
+        fail("Cannot create a temporary cache directory");
+        return;
+    }
+    m_clock.start();
+
+    m_server = new MockHomeyServer(m_options.devices, &m_clock);
+    m_server->moveToThread(&m_serverThread);
+    QObject::connect(&m_serverThread, &QThread::finished, m_server, &QObject::deleteLater);
+    m_serverThread.start();
+
+    bool listening = false;
+    QMetaObject::invokeMethod(m_server, "listen", Qt::BlockingQueuedConnection, Q_RETURN_ARG(bool, listening));
+    if (!listening) {
+        fail("Cannot start the mock Homey server");
+        return;
+    }
+
+    // only the WebSocket connection to the mock server: no mDNS, album art or snapshot from an earlier run
+    QVariantMap data;
+    data.insert(Integration::KEY_DATA_IP, "127.0.0.1");
+    data.insert("port", m_server->port());
+    data.insert("update_interval", m_options.updateInterval);
+    data.insert("album_art_size", 0);
+    data.insert("mdns", false);
+    data.insert("cache_path", m_cacheDir.path());
+
+    QVariantMap config;
+    config.insert(Integration::KEY_ID, "homey");
+    config.insert(Integration::KEY_FRIENDLYNAME, "Homey");
+    config.insert(Integration::OBJ_DATA, data);
+
+    m_homey = new Homey(config, m_entities, &m_notifications, &m_api, nullptr, m_plugin);
+    m_homey->moveToThread(&m_homeyThread);
+    QObject::connect(&m_homeyThread, &QThread::finished, m_homey, &QObject::deleteLater);
+    m_homeyThread.start();
+
+    Homey *homey = m_homey;
+    QMetaObject::invokeMethod(m_homey, [homey]() { homey->connect(); }, Qt::QueuedConnection);
+
+    m_phase = REGISTERING;
+    m_phaseStart = m_clock.elapsed();
+    m_progressTimer->start();
+}
+
+void E2eBenchmark::onProgress() {
+    qint64 now = m_clock.elapsed();
+
+    switch (m_phase) {
+        case REGISTERING:
+            if (m_entities->entities().size() >= m_options.devices) {
+                qInfo() << "Registered" << m_options.devices << "entities in" << now - m_phaseStart << "ms";
+                m_phase = SYNCING;
+                m_phaseStart = now;
+                QMetaObject::invokeMethod(m_server, "requestEntities", Qt::QueuedConnection);
+                return;
+            }
+            break;
+        case SYNCING:
+            if (m_synced.size() >= m_options.devices) {
+                qInfo() << "Synced the states of" << m_options.devices << "entities in" << now - m_phaseStart << "ms";
+                startLoad();
+                return;
+            }
+            break;
+        case LOADING:
+            if (now - m_phaseStart >= m_options.duration * 1000) {
+                QMetaObject::invokeMethod(m_server, "stopEvents", Qt::BlockingQueuedConnection);
+                m_commandTimer->stop();
+                m_loadEnd = m_clock.nsecsElapsed();
+                m_eventsAtLoadEnd = m_server->eventsSent();
+                m_phase = DRAINING;
+                m_phaseStart = now;
+            }
+            return;
+        case DRAINING:
+            if (now - m_phaseStart >= DRAIN_TIME) {
+                finish();
+            }
+            return;
+        case IDLE:
+            return;
+    }
+
+    if (now - m_phaseStart > SETUP_TIMEOUT) {
+        fail(m_phase == REGISTERING ? QString("Timeout registering the entities: %1 of %2")
+                                          .arg(m_entities->entities().size())
+                                          .arg(m_options.devices)
+                                    : QString("Timeout syncing the states: %1 of %2")
+                                          .arg(m_synced.size())
+                                          .arg(m_options.devices));
+    }
+}
+
+void E2eBenchmark::startLoad() {
+    qInfo() << "Sending" << m_options.eventRate << "events/s and" << m_options.commandRate << "commands/s for"
+            << m_options.duration << "s";
+
+    m_phase = LOADING;
+    m_phaseStart = m_clock.elapsed();
+    m_loadStart = m_clock.nsecsElapsed();
+    m_eventsAtLoadStart = m_server->eventsSent();
+    m_latencies.reserve(m_options.eventRate * m_options.duration);
+
+    QMetaObject::invokeMethod(m_server, "startEvents", Qt::QueuedConnection, Q_ARG(int, m_options.eventRate));
+    if (m_options.commandRate > 0) {
+        m_commandTimer->start();
+    }
+}
+
+void E2eBenchmark::onEntityChanged(const QString &entityId, int attribute) {
+    Q_UNUSED(attribute);
+
+    if (m_phase == SYNCING) {
+        m_synced.insert(entityId);
+        return;
+    }
+    if (m_phase != LOADING && m_phase != DRAINING) {
+        return;
+    }
+
+    // from sending the latest event of the device to the change of the entity: includes the coalescing of updates
+    m_entityChanges++;
+    qint64 sent = m_server->sentAt(entityId);
+    if (sent >= 0) {
+        m_latencies.append((m_clock.nsecsElapsed() - sent) / 1000);
+    }
+}
+
+void E2eBenchmark::onCommandTimeout() {
+    // round robin over the devices, every round switches them all on or off
+    const QString entityId = MockHomeyServer::deviceId(m_nextCommandDevice);
+    const int     command = (m_commandsSent / m_options.devices) % 2 == 0 ? LightDef::C_ON : LightDef::C_OFF;
+    m_nextCommandDevice = (m_nextCommandDevice + 1) % m_options.devices;
+    m_commandsSent++;
+
+    Homey *homey = m_homey;
+    QMetaObject::invokeMethod(
+        m_homey, [homey, entityId, command]() { homey->sendCommand("light", entityId, command, QVariant()); },
+        Qt::QueuedConnection);
+}
+
+void E2eBenchmark::finish() {
+    QJsonObject result = report();
+    QTextStream(stdout) << QJsonDocument(result).toJson(QJsonDocument::Indented);
+
+    shutdown();
+    emit finished(0);
+}
+
+void E2eBenchmark::fail(const QString &reason) {
+    qCritical().noquote() << reason;
+    shutdown();
+    emit finished(1);
+}
+
+void E2eBenchmark::shutdown() {
+    m_phase = IDLE;
+    m_progressTimer->stop();
+    m_commandTimer->stop();
+
+    if (m_homeyThread.isRunning()) {
+        // the integration might be waiting for an entity created in this thread: keep processing events
+        Homey *homey = m_homey;
+        QMetaObject::invokeMethod(m_homey,
+                                  [homey]() {
+                                      homey->disconnect();
+                                      homey->thread()->quit();
+                                  },
+                                  Qt::QueuedConnection);
+        while (!m_homeyThread.wait(10)) {
+            QCoreApplication::processEvents();
+        }
+    }
+    m_homey = nullptr;
+
+    if (m_serverThread.isRunning()) {
+        m_serverThread.quit();
+        m_serverThread.wait();
+    }
+    m_server = nullptr;
+}
+
+QJsonObject E2eBenchmark::report() {
+    // the integration's own statistics, read in its thread
+    QVariantMap commands;
+    QVariantMap metrics;
+    QMetaObject::invokeMethod(m_homey, "commandStatistics", Qt::BlockingQueuedConnection,
+                              Q_RETURN_ARG(QVariantMap, commands));
+    QMetaObject::invokeMethod(m_homey, "metrics", Qt::BlockingQueuedConnection, Q_RETURN_ARG(QVariantMap, metrics));
+
+    double seconds = (m_loadEnd - m_loadStart) / 1000000000.0;
+    double events = static_cast<double>(m_eventsAtLoadEnd - m_eventsAtLoadStart);
+
+    QJsonObject result;
+    result.insert("devices", m_options.devices);
+    result.insert("event_rate", m_options.eventRate);
+    result.insert("command_rate", m_options.commandRate);
+    result.insert("update_interval_ms", m_options.updateInterval);
+    result.insert("duration_s", seconds);
+    result.insert("events_sent", events);
+    result.insert("events_per_sec", seconds > 0 ? events / seconds : 0);
+    result.insert("entity_changes", m_entityChanges);
+    result.insert("entity_changes_per_sec", seconds > 0 ? m_entityChanges / seconds : 0);
+    result.insert("update_latency_us", percentiles(m_latencies));
+    result.insert("commands_sent", m_commandsSent);
+    result.insert("commands_received", static_cast<double>(m_server->commandsReceived()));
+    result.insert("command_rtt_ms", QJsonObject::fromVariantMap(commands));
+    result.insert("notifications", m_notifications.count());
+    result.insert("peak_memory_kb", peakMemory());
+    result.insert("metrics", QJsonObject::fromVariantMap(metrics));
+    return result;
+}
+
+QJsonObject E2eBenchmark::percentiles(QVector<qint64> samples) {
+    QJsonObject result;
+    result.insert("count", samples.size());
+    if (samples.isEmpty()) {
+        return result;
+    }
+
+    std::sort(samples.begin(), samples.end());
+    auto percentile = [&samples](int p) {
+        int index = qMin(samples.size() - 1, samples.size() * p / 100);
+        return samples.at(index);
+    };
+    result.insert("p50", percentile(50));
+    result.insert("p95", percentile(95));
+    result.insert("p99", percentile(99));
+    result.insert("max", samples.last());
+    return result;
+}
+
+qint64 E2eBenchmark::peakMemory() {
+#ifdef Q_OS_UNIX
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) == 0) {
+#ifdef Q_OS_MACOS
+        return usage.ru_maxrss / 1024;
+#else
+        return usage.ru_maxrss;
+#endif
+    }
+#endif
+    return -1;
+}
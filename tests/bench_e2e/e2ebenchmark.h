@@ -0,0 +1,111 @@
+/******************************************************************************
+ *
+ * Copyright (C) 2019-2020 Marton Borzak <hello@martonborzak.com>
+ *
+ * This file is part of the YIO-Remote software project.
+ *
+ * YIO-Remote software is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * YIO-Remote software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with YIO-Remote software. If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *****************************************************************************/
+
+#pragma once
+
+#include <QElapsedTimer>
+#include <QJsonObject>
+#include <QObject>
+#include <QSet>
+#include <QString>
+#include <QTemporaryDir>
+#include <QThread>
+#include <QTimer>
+#include <QVector>
+
+#include "homey.h"
+#include "mockhomeyserver.h"
+#include "stubs.h"
+
+// End-to-end load and latency measurement of the integration against a MockHomeyServer, fully offline. Like in the
+// application the integration runs in a worker thread and the entities in the main thread, the mock server has its own
+// thread. After the entities are registered and their states synced, the mock server sends events at the given rate
+// and commands are sent to the integration for the given duration. The report is written to stdout as JSON.
+class E2eBenchmark : public QObject {
+    Q_OBJECT
+
+ public:
+    struct Options {
+        int devices = 100;
+        int eventRate = 1000;   // events per second sent by the mock server
+        int commandRate = 10;   // commands per second sent to the integration
+        int duration = 10;      // seconds of load
+        int updateInterval = DEFAULT_UPDATE_INTERVAL;
+    };
+
+    explicit E2eBenchmark(const Options& options, QObject* parent = nullptr);
+    ~E2eBenchmark() override;
+
+ signals:
+    // exit code of the benchmark
+    void finished(int result);
+
+ public slots:
+    void start();
+
+ private slots:
+    void onProgress();
+    void onEntityChanged(const QString& entityId, int attribute);
+    void onCommandTimeout();
+
+ private:
+    enum Phase { IDLE, REGISTERING, SYNCING, LOADING, DRAINING };
+
+    void startLoad();
+    void finish();
+    void fail(const QString& reason);
+    void shutdown();
+
+    QJsonObject        report();
+    static QJsonObject percentiles(QVector<qint64> samples);
+
+    // peak resident memory of the process in KB, -1 if unknown
+    static qint64 peakMemory();
+
+    Options           m_options;
+    QElapsedTimer     m_clock;
+    QTemporaryDir     m_cacheDir;
+    StubEntities*     m_entities;
+    StubYioApi        m_api;
+    StubNotifications m_notifications;
+    HomeyPlugin*      m_plugin;
+    Homey*            m_homey = nullptr;
+    QThread           m_homeyThread;
+    MockHomeyServer*  m_server = nullptr;
+    QThread           m_serverThread;
+    QTimer*           m_progressTimer;
+    QTimer*           m_commandTimer;
+
+    Phase         m_phase = IDLE;
+    qint64        m_phaseStart = 0;
+    QSet<QString> m_synced;
+
+    // measurement: times of the clock in ns, latencies in us
+    qint64          m_loadStart = 0;
+    qint64          m_loadEnd = 0;
+    quint64         m_eventsAtLoadStart = 0;
+    quint64         m_eventsAtLoadEnd = 0;
+    qint64          m_entityChanges = 0;
+    QVector<qint64> m_latencies;
+    int             m_commandsSent = 0;
+    int             m_nextCommandDevice = 0;
+};
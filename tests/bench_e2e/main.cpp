@@ -0,0 +1,65 @@
+/******************************************************************************
+ *
+ * Copyright (C) 2019-2020 Marton Borzak <hello@martonborzak.com>
+ *
+ * This file is part of the YIO-Remote software project.
+ *
+ * YIO-Remote software is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * YIO-Remote software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with YIO-Remote software. If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *****************************************************************************/
+
+#include <QCommandLineOption>
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QLoggingCategory>
+#include <QTimer>
+
+#include "e2ebenchmark.h"
+
+int main(int argc, char *argv[]) {
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("bench_e2e");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("End-to-end benchmark of the Homey integration against a mock Homey app.");
+    parser.addHelpOption();
+
+    QCommandLineOption devices("devices", "Number of Homey devices.", "count", "100");
+    QCommandLineOption rate("rate", "Events per second sent by the mock Homey app.", "events", "1000");
+    QCommandLineOption commandRate("command-rate", "Commands per second sent to Homey, 0 for none.", "commands", "10");
+    QCommandLineOption duration("duration", "Measurement time in seconds.", "seconds", "10");
+    QCommandLineOption updateInterval("update-interval", "Interval in ms for applying entity updates, 0 for none.",
+                                      "ms", QString::number(DEFAULT_UPDATE_INTERVAL));
+    QCommandLineOption verbose("verbose", "Debug output of the integration.");
+    parser.addOptions({devices, rate, commandRate, duration, updateInterval, verbose});
+    parser.process(app);
+
+    E2eBenchmark::Options options;
+    options.devices = qMax(1, parser.value(devices).toInt());
+    options.eventRate = qMax(0, parser.value(rate).toInt());
+    options.commandRate = qMax(0, parser.value(commandRate).toInt());
+    options.duration = qMax(1, parser.value(duration).toInt());
+    options.updateInterval = qMax(0, parser.value(updateInterval).toInt());
+
+    if (!parser.isSet(verbose)) {
+        QLoggingCategory::setFilterRules("*.debug=false");
+    }
+
+    E2eBenchmark benchmark(options);
+    QObject::connect(&benchmark, &E2eBenchmark::finished, &app, &QCoreApplication::exit, Qt::QueuedConnection);
+    QTimer::singleShot(0, &benchmark, &E2eBenchmark::start);
+
+    return app.exec();
+}
@@ -0,0 +1,228 @@
+/******************************************************************************
+ *
+ * Copyright (C) 2019-2020 Marton Borzak <hello@martonborzak.com>
+ *
+ * This file is part of the YIO-Remote software project.
+ *
+ * YIO-Remote software is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * YIO-Remote software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with YIO-Remote software. If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *****************************************************************************/
+
+#include "mockhomeyserver.h"
+
+#include <QHostAddress>
+#include <QJsonDocument>
+#include <QMutexLocker>
+
+// upper bound of events per timer tick: a stalled event loop doesn't end in one huge burst
+static const int MAX_EVENTS_PER_TICK = 10000;
+
+MockHomeyServer::MockHomeyServer(int devices, const QElapsedTimer *clock, QObject *parent)
+    : QObject(parent), m_clock(clock), m_onoff(devices, false), m_dim(devices, 50) {
+    m_server = new QWebSocketServer(QStringLiteral("Homey mock"), QWebSocketServer::NonSecureMode, this);
+    QObject::connect(m_server, &QWebSocketServer::newConnection, this, &MockHomeyServer::onNewConnection);
+
+    m_eventTimer = new QTimer(this);
+    m_eventTimer->setTimerType(Qt::PreciseTimer);
+    m_eventTimer->setInterval(1);
+    QObject::connect(m_eventTimer, &QTimer::timeout, this, &MockHomeyServer::onEventTimeout);
+
+    m_index.reserve(devices);
+    for (int i = 0; i < devices; i++) {
+        m_index.insert(deviceId(i), i);
+    }
+}
+
+QString MockHomeyServer::deviceId(int index) {
+    return QString("device-%1").arg(index, 5, 10, QLatin1Char('0'));
+}
+
+qint64 MockHomeyServer::sentAt(const QString &deviceId) const {
+    QMutexLocker locker(&m_mutex);
+    return m_sentAt.value(deviceId, -1);
+}
+
+bool MockHomeyServer::listen() {
+    if (!m_server->listen(QHostAddress::LocalHost)) {
+        return false;
+    }
+    m_port = m_server->serverPort();
+    return true;
+}
+
+void MockHomeyServer::requestEntities() {
+    if (m_client) {
+        m_client->sendTextMessage(QStringLiteral("{\"type\":\"command\",\"command\":\"getEntities\"}"));
+    }
+}
+
+void MockHomeyServer::startEvents(int rate) {
+    m_rate = rate;
+    m_rateEvents = 0;
+    m_rateClock.start();
+    if (rate > 0) {
+        m_eventTimer->start();
+    }
+}
+
+void MockHomeyServer::stopEvents() {
+    m_eventTimer->stop();
+}
+
+void MockHomeyServer::onNewConnection() {
+    QWebSocket *client = m_server->nextPendingConnection();
+    if (m_client) {
+        // a reconnect of the integration replaces the old connection
+        m_client->deleteLater();
+    }
+    m_client = client;
+    QObject::connect(m_client, &QWebSocket::textMessageReceived, this, &MockHomeyServer::onTextMessageReceived);
+    QObject::connect(m_client, &QWebSocket::disconnected, this, &MockHomeyServer::onDisconnected);
+
+    // the optional protocol features measured by the benchmark
+    m_client->sendTextMessage(
+        QStringLiteral("{\"type\":\"connected\",\"features\":[\"command_result\",\"subscribe\"]}"));
+    m_client->sendTextMessage(catalogMessage());
+}
+
+void MockHomeyServer::onDisconnected() {
+    QWebSocket *client = qobject_cast<QWebSocket *>(sender());
+    if (client == m_client) {
+        m_client = nullptr;
+    }
+    if (client) {
+        client->deleteLater();
+    }
+}
+
+void MockHomeyServer::onTextMessageReceived(const QString &message) {
+    QJsonObject root = QJsonDocument::fromJson(message.toUtf8()).object();
+    QString     type = root.value(QLatin1String("type")).toString();
+
+    if (type == QLatin1String("getEntities")) {
+        sendStates(root.value(QLatin1String("devices")).toArray());
+    } else if (type == QLatin1String("command")) {
+        m_commandsReceived++;
+        sendCommandResult(root);
+    }
+}
+
+QString MockHomeyServer::catalogMessage() const {
+    QJsonArray entities;
+    for (int i = 0; i < m_onoff.size(); i++) {
+        QJsonObject entity;
+        entity.insert("entity_id", deviceId(i));
+        entity.insert("type", "light");
+        entity.insert("friendly_name", QString("Light %1").arg(i + 1));
+        entity.insert("supported_features", QJsonArray{"BRIGHTNESS"});
+        entities.append(entity);
+    }
+
+    QJsonObject catalog;
+    catalog.insert("type", "sendEntities");
+    catalog.insert("available_entities", entities);
+    return QString::fromUtf8(QJsonDocument(catalog).toJson(QJsonDocument::Compact));
+}
+
+void MockHomeyServer::sendStates(const QJsonArray &devices) {
+    if (!m_client) {
+        return;
+    }
+
+    QJsonArray states;
+    for (const QJsonValue &device : devices) {
+        int index = m_index.value(device.toString(), -1);
+        if (index < 0) {
+            continue;
+        }
+        QJsonObject state;
+        state.insert("entity_id", device.toString());
+        state.insert("onoff", m_onoff.at(index));
+        state.insert("dim", m_dim.at(index) / 100.0);
+        states.append(state);
+    }
+
+    QJsonObject batch;
+    batch.insert("type", "sendStatesBatch");
+    batch.insert("data", states);
+
+    {
+        QMutexLocker locker(&m_mutex);
+        qint64       now = m_clock->nsecsElapsed();
+        for (const QJsonValue &device : devices) {
+            m_sentAt.insert(device.toString(), now);
+        }
+    }
+    m_client->sendTextMessage(QString::fromUtf8(QJsonDocument(batch).toJson(QJsonDocument::Compact)));
+}
+
+void MockHomeyServer::sendCommandResult(const QJsonObject &command) {
+    QString deviceId = command.value(QLatin1String("deviceId")).toString();
+    int     index = m_index.value(deviceId, -1);
+    QString capability = command.value(QLatin1String("command")).toString();
+    if (index < 0 || !m_client) {
+        return;
+    }
+
+    // {"type":"command","command":"<capability>","value":<value>,"deviceId":"<deviceId>","id":<id>}
+    QJsonValue value = command.value(QLatin1String("value"));
+    QString    data;
+    if (capability == QLatin1String("onoff")) {
+        m_onoff[index] = value.toBool();
+        data = QString("\"onoff\":%1").arg(m_onoff.at(index) ? "true" : "false");
+    } else if (capability == QLatin1String("dim")) {
+        m_dim[index] = qRound(value.toDouble() * 100);
+        data = QString("\"dim\":%1").arg(m_dim.at(index) / 100.0);
+    }
+
+    QJsonValue id = command.value(QLatin1String("id"));
+    if (id.isDouble()) {
+        m_client->sendTextMessage(QString("{\"type\":\"result\",\"id\":%1}").arg(id.toInt()));
+    }
+    if (!data.isEmpty()) {
+        sendEvent(index, data);
+    }
+}
+
+void MockHomeyServer::onEventTimeout() {
+    if (!m_client || m_onoff.isEmpty()) {
+        return;
+    }
+
+    // catch up with the rate: the timer doesn't fire exactly every millisecond
+    quint64 due = static_cast<quint64>(m_rateClock.nsecsElapsed() / 1000000000.0 * m_rate);
+    for (int burst = 0; m_rateEvents < due && burst < MAX_EVENTS_PER_TICK; burst++) {
+        int index = m_nextDevice;
+        m_nextDevice = (m_nextDevice + 1) % m_onoff.size();
+
+        // always a new value: the integration skips unchanged values
+        m_dim[index] = m_dim.at(index) % 100 + 1;
+        sendEvent(index, QString("\"dim\":%1").arg(m_dim.at(index) / 100.0));
+        m_rateEvents++;
+    }
+}
+
+void MockHomeyServer::sendEvent(int index, const QString &data) {
+    // same layout as the Homey app: no whitespace, entity_id first
+    const QString device = deviceId(index);
+    QString       message = QString("{\"type\":\"event\",\"data\":{\"entity_id\":\"%1\",%2}}").arg(device, data);
+
+    {
+        QMutexLocker locker(&m_mutex);
+        m_sentAt.insert(device, m_clock->nsecsElapsed());
+    }
+    m_client->sendTextMessage(message);
+    m_eventsSent++;
+}
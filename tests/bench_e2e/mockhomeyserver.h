@@ -0,0 +1,101 @@
+/******************************************************************************
+ *
+ * Copyright (C) 2019-2020 Marton Borzak <hello@martonborzak.com>
+ *
+ * This file is part of the YIO-Remote software project.
+ *
+ * YIO-Remote software is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * YIO-Remote software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with YIO-Remote software. If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *****************************************************************************/
+
+#pragma once
+
+#include <atomic>
+
+#include <QElapsedTimer>
+#include <QHash>
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QMutex>
+#include <QObject>
+#include <QString>
+#include <QTimer>
+#include <QVector>
+#include <QtWebSockets/QWebSocket>
+#include <QtWebSockets/QWebSocketServer>
+
+// Stand-in for the YIO app on Homey: a catalog of dimmable lights, their states and events at a given rate. Commands
+// are answered with a result and the event of the changed device, like the Homey app does.
+//
+// Protocol: on connect the server sends "connected" and the "sendEntities" catalog. requestEntities() sends the
+// "getEntities" command, the integration answers with the loaded devices and gets their states in one
+// "sendStatesBatch". "subscribe", "standby" and "resume" are accepted and ignored.
+class MockHomeyServer : public QObject {
+    Q_OBJECT
+
+ public:
+    // 'clock' is shared with the benchmark for the send times of the events
+    MockHomeyServer(int devices, const QElapsedTimer* clock, QObject* parent = nullptr);
+
+    static QString deviceId(int index);
+
+    // time in ns of the clock the last event or state of the device was sent, -1 if never. Thread safe.
+    qint64 sentAt(const QString& deviceId) const;
+
+    quint16 port() const { return m_port; }
+    quint64 eventsSent() const { return m_eventsSent; }
+    quint64 commandsReceived() const { return m_commandsReceived; }
+
+ public slots:
+    // listens on a free port of the loopback interface
+    bool listen();
+    void requestEntities();
+    void startEvents(int rate);
+    void stopEvents();
+
+ private slots:
+    void onNewConnection();
+    void onTextMessageReceived(const QString& message);
+    void onDisconnected();
+    void onEventTimeout();
+
+ private:
+    QString catalogMessage() const;
+    void    sendStates(const QJsonArray& devices);
+    void    sendCommandResult(const QJsonObject& command);
+    void    sendEvent(int index, const QString& data);
+
+    QWebSocketServer*    m_server;
+    QWebSocket*          m_client = nullptr;
+    quint16              m_port = 0;
+    const QElapsedTimer* m_clock;
+
+    // device states, same index as the devices: dim in percent
+    QVector<bool>       m_onoff;
+    QVector<int>        m_dim;
+    QHash<QString, int> m_index;
+
+    // events at m_rate per second since m_rateClock started, round robin over the devices
+    QTimer*       m_eventTimer;
+    QElapsedTimer m_rateClock;
+    int           m_rate = 0;
+    quint64       m_rateEvents = 0;
+    int           m_nextDevice = 0;
+
+    mutable QMutex         m_mutex;
+    QHash<QString, qint64> m_sentAt;
+    std::atomic<quint64>   m_eventsSent{0};
+    std::atomic<quint64>   m_commandsReceived{0};
+};
@@ -0,0 +1,6 @@
+# QTest benchmarks of the message parsing, entity update and command serialization hot paths
+TARGET = bench_hotpaths
+
+include(../common.pri)
+
+SOURCES += tst_bench_hotpaths.cpp
@@ -0,0 +1,445 @@
+/******************************************************************************
+ *
+ * Copyright (C) 2019-2020 Marton Borzak <hello@martonborzak.com>
+ *
+ * This file is part of the YIO-Remote software project.
+ *
+ * YIO-Remote software is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * YIO-Remote software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with YIO-Remote software. If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *****************************************************************************/
+
+#include <QColor>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QTemporaryDir>
+#include <QtTest>
+
+#include "homey.h"
+#include "stubs.h"
+#include "yio-interface/entities/blindinterface.h"
+#include "yio-interface/entities/climateinterface.h"
+#include "yio-interface/entities/lightinterface.h"
+#include "yio-interface/entities/mediaplayerinterface.h"
+#include "yio-interface/entities/switchinterface.h"
+
+static const char INTEGRATION_ID[] = "homey";
+static const char DEVICE_ID[] = "78f3ab16-c622-4bd7-aebf-3ca981e41375";
+
+// Hot paths of the integration with stable synthetic inputs: message parsing per message type, the entity update
+// path, the rgb_color conversion and the command serialization. Homey runs in the test thread without a socket, the
+// outgoing messages are dropped by the outbox. Use -median or -callgrind for stable numbers.
+class BenchHotPaths : public QObject {
+    Q_OBJECT
+
+ private slots:
+    void initTestCase();
+    void cleanupTestCase();
+
+    void parseMessage_data();
+    void parseMessage();
+    void updateEntity_data();
+    void updateEntity();
+    void colorName_data();
+    void colorName();
+    void serializeCommand_data();
+    void serializeCommand();
+    void sendCommand_data();
+    void sendCommand();
+    void commandMessage_data();
+    void commandMessage();
+    void nonFiniteCommand_data();
+    void nonFiniteCommand();
+
+ private:
+    // entity of the catalog, one per entity type: "<type>-1"
+    static QString     entityId(const QString& type) { return type + QStringLiteral("-1"); }
+    static QJsonObject catalogEntity(const QString& type);
+    static QString     catalogMessage();
+    static QString     toString(const QJsonObject& message);
+
+    QTemporaryDir     m_cacheDir;
+    StubEntities*     m_entities = nullptr;
+    StubYioApi*       m_api = nullptr;
+    StubNotifications m_notifications;
+    HomeyPlugin*      m_plugin = nullptr;
+    Homey*            m_homey = nullptr;
+};
+
+QJsonObject BenchHotPaths::catalogEntity(const QString& type) {
+    QJsonObject entity;
+    entity.insert("entity_id", entityId(type));
+    entity.insert("type", type);
+    entity.insert("friendly_name", type);
+    entity.insert("supported_features", QJsonArray());
+    return entity;
+}
+
+QString BenchHotPaths::catalogMessage() {
+    QJsonArray entities;
+    for (const char* type : {"light", "blind", "media_player", "climate", "switch"}) {
+        entities.append(catalogEntity(type));
+    }
+    QJsonObject message;
+    message.insert("type", "sendEntities");
+    message.insert("available_entities", entities);
+    return toString(message);
+}
+
+QString BenchHotPaths::toString(const QJsonObject& message) {
+    return QString::fromUtf8(QJsonDocument(message).toJson(QJsonDocument::Compact));
+}
+
+void BenchHotPaths::initTestCase() {
+    QVERIFY(m_cacheDir.isValid());
+
+    m_entities = new StubEntities(this);
+    m_api = new StubYioApi(m_entities);
+    m_plugin = new HomeyPlugin();
+
+    // updates and commands are handled right away: no update tick, no command rate limit, no background traffic
+    QVariantMap data;
+    data.insert(Integration::KEY_DATA_IP, "127.0.0.1");
+    data.insert("update_interval", 0);
+    data.insert("command_interval", 0);
+    data.insert("ping_interval", 0);
+    data.insert("album_art_size", 0);
+    data.insert("mdns", false);
+    data.insert("cache_path", m_cacheDir.path());
+
+    QVariantMap config;
+    config.insert(Integration::KEY_ID, INTEGRATION_ID);
+    config.insert(Integration::KEY_FRIENDLYNAME, "Homey");
+    config.insert(Integration::OBJ_DATA, data);
+    m_homey = new Homey(config, m_entities, &m_notifications, m_api, nullptr, m_plugin);
+
+    // the entities are created by the integration like with a live Homey
+    m_homey->onTextMessageReceived(catalogMessage());
+    QCOMPARE(m_entities->entities().size(), 5);
+    QVERIFY(!m_homey->isRegisteringEntities());
+}
+
+void BenchHotPaths::cleanupTestCase() {
+    delete m_homey;
+    delete m_api;
+    delete m_plugin;
+}
+
+void BenchHotPaths::parseMessage_data() {
+    // two frames of each type with different values, sent alternately: the updates are never skipped as unchanged
+    QTest::addColumn<QString>("first");
+    QTest::addColumn<QString>("second");
+
+    const QString event(
+        "{\"type\":\"event\",\"data\":{\"entity_id\":\"light-1\",\"onoff\":%1,\"dim\":%2,"
+        "\"attributes\":{\"rgb_color\":[255,%3,0]}}}");
+    QTest::newRow("event") << event.arg("true").arg(0.5).arg(128) << event.arg("false").arg(0.25).arg(64);
+
+    const QString states(
+        "{\"type\":\"sendStates\",\"data\":{\"entity_id\":\"media_player-1\",\"onoff\":true,\"speaker_playing\":%1,"
+        "\"volume_set\":%2,\"speaker_track\":\"%3\",\"speaker_artist\":\"Artist\","
+        "\"attributes\":{\"media_content_type\":\"music\"}}}");
+    QTest::newRow("sendStates") << states.arg("true").arg(0.4).arg("Track 1")
+                                << states.arg("false").arg(0.6).arg("Track 2");
+
+    const QString batch(
+        "{\"type\":\"sendStatesBatch\",\"data\":["
+        "{\"entity_id\":\"light-1\",\"onoff\":%1,\"dim\":%2},"
+        "{\"entity_id\":\"blind-1\",\"windowcoverings_set\":%2,\"windowcoverings_closed\":%1},"
+        "{\"entity_id\":\"media_player-1\",\"onoff\":%1,\"volume_set\":%2},"
+        "{\"entity_id\":\"climate-1\",\"onoff\":%1,\"target_temperature\":%3,\"measure_temperature\":%3},"
+        "{\"entity_id\":\"switch-1\",\"onoff\":%1}]}");
+    QTest::newRow("sendStatesBatch") << batch.arg("true").arg(0.3).arg(21.5) << batch.arg("false").arg(0.7).arg(19);
+
+    QTest::newRow("result") << QString("{\"type\":\"result\",\"id\":1}") << QString("{\"type\":\"result\",\"id\":2}");
+
+    const QString connected("{\"type\":\"connected\",\"features\":[\"batch_states\",\"subscribe\"]}");
+    QTest::newRow("connected") << connected << connected;
+
+    const QString command("{\"type\":\"command\",\"command\":\"getEntities\"}");
+    QTest::newRow("command") << command << command;
+
+    // unchanged catalog: the registered entities are kept
+    QTest::newRow("sendEntities") << catalogMessage() << catalogMessage();
+
+    QTest::newRow("unknown") << QString("{\"type\":\"unknown\"}") << QString("{\"type\":\"unknown\"}");
+}
+
+void BenchHotPaths::parseMessage() {
+    QFETCH(QString, first);
+    QFETCH(QString, second);
+
+    const QString frames[2] = {first, second};
+    int           i = 0;
+    QBENCHMARK {
+        m_homey->onTextMessageReceived(frames[i++ & 1]);
+    }
+
+    // the data tags are the message type names of the metrics
+    QVariantMap messages = m_homey->metrics().value("messages").toMap();
+    QVERIFY(messages.value(QTest::currentDataTag()).toULongLong() > 0);
+    QCOMPARE(m_entities->entities().size(), 5);
+}
+
+void BenchHotPaths::updateEntity_data() {
+    QTest::addColumn<QString>("type");
+    QTest::addColumn<QByteArray>("first");
+    QTest::addColumn<QByteArray>("second");
+
+    QTest::newRow("light") << QString("light")
+                           << QByteArray("{\"entity_id\":\"light-1\",\"onoff\":true,\"dim\":0.5,"
+                                         "\"attributes\":{\"rgb_color\":[255,128,0]}}")
+                           << QByteArray("{\"entity_id\":\"light-1\",\"onoff\":false,\"dim\":0.25,"
+                                         "\"attributes\":{\"rgb_color\":[0,128,255]}}");
+    QTest::newRow("blind") << QString("blind")
+                           << QByteArray("{\"entity_id\":\"blind-1\",\"windowcoverings_set\":0.3,"
+                                         "\"windowcoverings_closed\":false}")
+                           << QByteArray("{\"entity_id\":\"blind-1\",\"windowcoverings_set\":1,"
+                                         "\"windowcoverings_closed\":\"true\"}");
+    QTest::newRow("media_player") << QString("media_player")
+                                  << QByteArray("{\"entity_id\":\"media_player-1\",\"onoff\":true,"
+                                                "\"speaker_playing\":true,\"volume_set\":0.4,"
+                                                "\"speaker_track\":\"Track 1\",\"speaker_artist\":\"Artist 1\","
+                                                "\"album_art\":\"http://127.0.0.1/1.jpg\","
+                                                "\"attributes\":{\"media_content_type\":\"music\"}}")
+                                  << QByteArray("{\"entity_id\":\"media_player-1\",\"onoff\":true,"
+                                                "\"speaker_playing\":false,\"volume_set\":0.6,"
+                                                "\"speaker_track\":\"Track 2\",\"speaker_artist\":\"Artist 2\","
+                                                "\"album_art\":\"http://127.0.0.1/2.jpg\","
+                                                "\"attributes\":{\"media_content_type\":\"podcast\"}}");
+    QTest::newRow("climate") << QString("climate")
+                             << QByteArray("{\"entity_id\":\"climate-1\",\"onoff\":true,"
+                                           "\"target_temperature\":21.5,\"measure_temperature\":20.1}")
+                             << QByteArray("{\"entity_id\":\"climate-1\",\"onoff\":false,"
+                                           "\"target_temperature\":19,\"measure_temperature\":20.4}");
+    QTest::newRow("switch") << QString("switch") << QByteArray("{\"entity_id\":\"switch-1\",\"onoff\":true}")
+                            << QByteArray("{\"entity_id\":\"switch-1\",\"onoff\":false}");
+}
+
+void BenchHotPaths::updateEntity() {
+    QFETCH(QString, type);
+    QFETCH(QByteArray, first);
+    QFETCH(QByteArray, second);
+
+    // decoded beforehand: only the mapping to the entity and the entity changes are measured
+    const HomeyStateUpdate updates[2] = {HomeyStateUpdate::fromJson(QJsonDocument::fromJson(first).object()),
+                                         HomeyStateUpdate::fromJson(QJsonDocument::fromJson(second).object())};
+
+    StubEntity* entity = qobject_cast<StubEntity*>(m_entities->get(entityId(type)));
+    QVERIFY(entity);
+    const int changes = entity->changes();
+
+    int i = 0;
+    QBENCHMARK {
+        m_homey->updateEntity(updates[i++ & 1]);
+        m_homey->applyEntityMutations();
+    }
+
+    QVERIFY(entity->changes() > changes);
+}
+
+void BenchHotPaths::colorName_data() {
+    QTest::addColumn<QByteArray>("data");
+    QTest::addColumn<QString>("name");
+
+    QTest::newRow("orange") << QByteArray("{\"attributes\":{\"rgb_color\":[255,128,0]}}") << QString("#FF8000");
+    QTest::newRow("black") << QByteArray("{\"attributes\":{\"rgb_color\":[0,0,0]}}") << QString("#000000");
+    QTest::newRow("fraction") << QByteArray("{\"attributes\":{\"rgb_color\":[15.6,16.4,254.5]}}")
+                              << QString("#1010FF");
+    QTest::newRow("out of range") << QByteArray("{\"attributes\":{\"rgb_color\":[300,-5,16]}}") << QString("#FF0010");
+}
+
+void BenchHotPaths::colorName() {
+    QFETCH(QByteArray, data);
+    QFETCH(QString, name);
+
+    const HomeyStateUpdate update = HomeyStateUpdate::fromJson(QJsonDocument::fromJson(data).object());
+    QVERIFY(update.has(HomeyStateUpdate::RGB_COLOR));
+
+    QString result;
+    QBENCHMARK {
+        result = update.colorName();
+    }
+    QCOMPARE(result, name);
+}
+
+void BenchHotPaths::serializeCommand_data() {
+    // every mapped command of every entity type
+    QTest::addColumn<QString>("type");
+    QTest::addColumn<int>("command");
+    QTest::addColumn<QVariant>("param");
+    QTest::addColumn<QByteArray>("capability");
+    QTest::addColumn<QByteArray>("value");
+
+    auto row = [](const char* tag, const char* type, int command, const QVariant& param, const char* capability,
+                  const char* value) {
+        QTest::newRow(tag) << QString(type) << command << param << QByteArray(capability) << QByteArray(value);
+    };
+
+    row("light toggle", "light", LightDef::C_TOGGLE, QVariant(), "toggle", "true");
+    row("light on", "light", LightDef::C_ON, QVariant(), "onoff", "true");
+    row("light off", "light", LightDef::C_OFF, QVariant(), "onoff", "false");
+    row("light brightness", "light", LightDef::C_BRIGHTNESS, 50, "dim", "0.5");
+    row("light color", "light", LightDef::C_COLOR, QColor(255, 128, 0), "color", "[255,128,0]");
+
+    row("blind open", "blind", BlindDef::C_OPEN, QVariant(), "windowcoverings_closed", "\"false\"");
+    row("blind close", "blind", BlindDef::C_CLOSE, QVariant(), "windowcoverings_closed", "\"true\"");
+    row("blind stop", "blind", BlindDef::C_STOP, QVariant(), "windowcoverings_tilt_set", "0");
+    row("blind position", "blind", BlindDef::C_POSITION, 30, "windowcoverings_set", "0.3");
+
+    row("media_player volume", "media_player", MediaPlayerDef::C_VOLUME_SET, 40, "volume_set", "0.4");
+    row("media_player play", "media_player", MediaPlayerDef::C_PLAY, QVariant(), "speaker_playing", "true");
+    row("media_player stop", "media_player", MediaPlayerDef::C_STOP, QVariant(), "speaker_playing", "false");
+    row("media_player pause", "media_player", MediaPlayerDef::C_PAUSE, QVariant(), "speaker_playing", "false");
+    row("media_player previous", "media_player", MediaPlayerDef::C_PREVIOUS, QVariant(), "speaker_prev", "true");
+    row("media_player next", "media_player", MediaPlayerDef::C_NEXT, QVariant(), "speaker_next", "true");
+    row("media_player turn on", "media_player", MediaPlayerDef::C_TURNON, QVariant(), "onoff", "true");
+    row("media_player turn off", "media_player", MediaPlayerDef::C_TURNOFF, QVariant(), "onoff", "false");
+
+    row("climate on", "climate", ClimateDef::C_ON, QVariant(), "onoff", "true");
+    row("climate off", "climate", ClimateDef::C_OFF, QVariant(), "onoff", "false");
+    row("climate target", "climate", ClimateDef::C_TARGET_TEMPERATURE, 21.5, "target_temperature", "21.5");
+
+    row("switch toggle", "switch", SwitchDef::C_TOGGLE, QVariant(), "toggle", "true");
+    row("switch on", "switch", SwitchDef::C_ON, QVariant(), "onoff", "true");
+    row("switch off", "switch", SwitchDef::C_OFF, QVariant(), "onoff", "false");
+}
+
+void BenchHotPaths::serializeCommand() {
+    QFETCH(QString, type);
+    QFETCH(int, command);
+    QFETCH(QVariant, param);
+    QFETCH(QByteArray, capability);
+    QFETCH(QByteArray, value);
+
+    const HomeyCapabilityMap::Command* mapping =
+        HomeyCapabilityMap::command(HomeyCapabilityMap::entityKind(type), command);
+    QVERIFY(mapping);
+
+    QByteArray message;
+    QBENCHMARK {
+        message = HomeyCapabilityMap::message(*mapping, DEVICE_ID, param);
+    }
+
+    QCOMPARE(message, QByteArray("{\"type\":\"command\",\"command\":\"") + capability + "\",\"value\":" + value +
+                          ",\"deviceId\":\"" + DEVICE_ID + "\"}");
+    QVERIFY(QJsonDocument::fromJson(message).isObject());
+}
+
+void BenchHotPaths::sendCommand_data() {
+    serializeCommand_data();
+}
+
+void BenchHotPaths::sendCommand() {
+    // mapping, serialization and command queue of a command from the UI, the socket write is not included
+    QFETCH(QString, type);
+    QFETCH(int, command);
+    QFETCH(QVariant, param);
+
+    const QString entity = entityId(type);
+    QBENCHMARK {
+        m_homey->sendCommand(type, entity, command, param);
+    }
+}
+
+void BenchHotPaths::commandMessage_data() {
+    // the same commands serialized from a QVariantMap with QJsonDocument and from the pre-serialized templates
+    QTest::addColumn<QString>("type");
+    QTest::addColumn<int>("command");
+    QTest::addColumn<QVariant>("param");
+    QTest::addColumn<QVariant>("value");
+    QTest::addColumn<bool>("templates");
+
+    const QVariantList rgb{255, 128, 0};
+    for (bool templates : {false, true}) {
+        const char* path = templates ? "template" : "QJsonDocument";
+        QTest::newRow(qPrintable(QString("onoff %1").arg(path)))
+            << QString("light") << static_cast<int>(LightDef::C_ON) << QVariant() << QVariant(true) << templates;
+        QTest::newRow(qPrintable(QString("dim %1").arg(path)))
+            << QString("light") << static_cast<int>(LightDef::C_BRIGHTNESS) << QVariant(50) << QVariant(0.5)
+            << templates;
+        QTest::newRow(qPrintable(QString("color %1").arg(path)))
+            << QString("light") << static_cast<int>(LightDef::C_COLOR) << QVariant(QColor(255, 128, 0))
+            << QVariant(rgb) << templates;
+    }
+}
+
+void BenchHotPaths::commandMessage() {
+    QFETCH(QString, type);
+    QFETCH(int, command);
+    QFETCH(QVariant, param);
+    QFETCH(QVariant, value);
+    QFETCH(bool, templates);
+
+    const HomeyCapabilityMap::Command* mapping =
+        HomeyCapabilityMap::command(HomeyCapabilityMap::entityKind(type), command);
+    QVERIFY(mapping);
+    const QString capability = QString::fromLatin1(HomeyCapabilityMap::capability(*mapping));
+
+    QByteArray message;
+    if (templates) {
+        QBENCHMARK {
+            message = HomeyCapabilityMap::message(*mapping, DEVICE_ID, param);
+        }
+    } else {
+        QBENCHMARK {
+            QVariantMap map;
+            map.insert("type", "command");
+            map.insert("deviceId", DEVICE_ID);
+            map.insert("command", capability);
+            map.insert("value", value);
+            message = QJsonDocument::fromVariant(map).toJson(QJsonDocument::JsonFormat::Compact);
+        }
+    }
+
+    // same JSON object, only the key order differs
+    QJsonObject expected;
+    expected.insert("type", "command");
+    expected.insert("deviceId", DEVICE_ID);
+    expected.insert("command", capability);
+    expected.insert("value", QJsonValue::fromVariant(value));
+    QCOMPARE(QJsonDocument::fromJson(message).object(), expected);
+}
+
+void BenchHotPaths::nonFiniteCommand_data() {
+    QTest::addColumn<QString>("type");
+    QTest::addColumn<int>("command");
+    QTest::addColumn<double>("param");
+
+    QTest::newRow("dim NaN") << QString("light") << static_cast<int>(LightDef::C_BRIGHTNESS) << qQNaN();
+    QTest::newRow("position inf") << QString("blind") << static_cast<int>(BlindDef::C_POSITION) << qInf();
+    QTest::newRow("volume -inf") << QString("media_player") << static_cast<int>(MediaPlayerDef::C_VOLUME_SET)
+                                 << -qInf();
+    QTest::newRow("target NaN") << QString("climate") << static_cast<int>(ClimateDef::C_TARGET_TEMPERATURE)
+                                << qQNaN();
+}
+
+void BenchHotPaths::nonFiniteCommand() {
+    QFETCH(QString, type);
+    QFETCH(int, command);
+    QFETCH(double, param);
+
+    const HomeyCapabilityMap::Command* mapping =
+        HomeyCapabilityMap::command(HomeyCapabilityMap::entityKind(type), command);
+    QVERIFY(mapping);
+
+    // rejected: JSON has no NaN or infinity
+    QVERIFY(HomeyCapabilityMap::message(*mapping, DEVICE_ID, param).isEmpty());
+    QCOMPARE(HomeyCommandTemplate::number(param), QByteArray("null"));
+}
+
+QTEST_GUILESS_MAIN(BenchHotPaths)
+
+#include "tst_bench_hotpaths.moc"
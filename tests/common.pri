@@ -0,0 +1,37 @@
+# Shared settings of the test targets: the integration sources are built into the test executable together with
+# stub implementations of the YIO interfaces.
+TEMPLATE  = app
+CONFIG   += c++14 console testcase
+CONFIG   -= app_bundle
+QT       += testlib websockets network core gui quick
+
+INTG_LIB_PATH = $$(YIO_SRC)
+isEmpty(INTG_LIB_PATH) {
+    INTG_LIB_PATH = $$clean_path($$PWD/../../integrations.library)
+} else {
+    INTG_LIB_PATH = $$(YIO_SRC)/integrations.library
+}
+
+! include($$INTG_LIB_PATH/yio-plugin-lib.pri) {
+    error( "Cannot find the yio-plugin-lib.pri file!" )
+}
+
+# plugin metadata of HomeyPlugin, see homey.pro
+HOMEY_VERSION = test
+BUILDDATE = $$system(date +"%Y-%m-%dT%H:%M:%S")
+DEBUG_BUILD = true
+GIT_HASH = ""
+GIT_BRANCH = ""
+INTG_GIT_VERSION = "?"
+CFG_SCHEMA = "$$cat($$PWD/../setup-schema.json)"
+homey_json.input = $$PWD/../homey.json.in
+homey_json.output = $$OUT_PWD/homey.json
+QMAKE_SUBSTITUTES += homey_json
+INCLUDEPATH += $$OUT_PWD
+DEFINES += PLUGIN_VERSION=\\\"$$HOMEY_VERSION\\\"
+
+include($$PWD/../src/homey.pri)
+
+INCLUDEPATH += $$PWD/common
+HEADERS += $$PWD/common/stubs.h
+SOURCES += $$PWD/common/stubs.cpp
@@ -0,0 +1,197 @@
+/******************************************************************************
+ *
+ * Copyright (C) 2019-2020 Marton Borzak <hello@martonborzak.com>
+ *
+ * This file is part of the YIO-Remote software project.
+ *
+ * YIO-Remote software is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * YIO-Remote software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with YIO-Remote software. If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *****************************************************************************/
+
+#include "stubs.h"
+
+#include <QThread>
+#include <QtDebug>
+
+StubEntity::StubEntity(const QVariantMap &config, QObject *parent)
+    : QObject(parent),
+      m_entityId(config.value("entity_id").toString()),
+      m_type(config.value("type").toString()),
+      m_integration(config.value("integration").toString()),
+      m_friendlyName(config.value("friendly_name").toString()),
+      m_supportedFeatures(config.value("supported_features").toStringList()) {}
+
+bool StubEntity::isSupported(int feature) {
+    Q_UNUSED(feature);
+    return true;
+}
+
+bool StubEntity::setState(int state) {
+    m_state = state;
+    m_changes++;
+    emit changed(m_entityId, -1);
+    return true;
+}
+
+bool StubEntity::updateAttrByName(const QString &attrName, const QVariant &value) {
+    Q_UNUSED(attrName);
+    Q_UNUSED(value);
+    return false;
+}
+
+bool StubEntity::updateAttrByIndex(int attrIndex, const QVariant &value) {
+    if (attrIndex < 0) {
+        return false;
+    }
+    if (attrIndex >= m_attributes.size()) {
+        m_attributes.resize(attrIndex + 1);
+    }
+    m_attributes[attrIndex] = value;
+    m_changes++;
+    emit changed(m_entityId, attrIndex);
+    return true;
+}
+
+QList<QObject *> StubEntities::getByType(const QString &type) {
+    QList<QObject *> list;
+    for (StubEntity *entity : m_list) {
+        if (entity->type() == type) {
+            list.append(entity);
+        }
+    }
+    return list;
+}
+
+QList<QObject *> StubEntities::getByArea(const QString &area) {
+    Q_UNUSED(area);
+    return QList<QObject *>();
+}
+
+QList<QObject *> StubEntities::getByAreaType(const QString &area, const QString &type) {
+    Q_UNUSED(area);
+    Q_UNUSED(type);
+    return QList<QObject *>();
+}
+
+QList<EntityInterface *> StubEntities::getByIntegration(const QString &integration) {
+    QList<EntityInterface *> list;
+    for (StubEntity *entity : m_list) {
+        if (entity->integration() == integration) {
+            list.append(entity);
+        }
+    }
+    return list;
+}
+
+EntityInterface *StubEntities::getEntityInterface(const QString &entity_id) {
+    return m_entities.value(entity_id);
+}
+
+bool StubEntities::add(const QString &type, const QVariantMap &config, QObject *integrationObj) {
+    if (QThread::currentThread() != thread()) {
+        // called by an integration in its worker thread: the entities live in the application thread
+        bool added = false;
+        QMetaObject::invokeMethod(
+            this, [&]() { added = add(type, config, integrationObj); }, Qt::BlockingQueuedConnection);
+        return added;
+    }
+
+    Q_UNUSED(integrationObj);
+    const QString entityId = config.value("entity_id").toString();
+    if (entityId.isEmpty() || m_entities.contains(entityId)) {
+        return false;
+    }
+
+    QVariantMap entityConfig = config;
+    entityConfig.insert("type", type);
+    StubEntity *entity = new StubEntity(entityConfig, this);
+    QObject::connect(entity, &StubEntity::changed, this, &StubEntities::entityChanged);
+    m_entities.insert(entityId, entity);
+    m_list.append(entity);
+    return true;
+}
+
+void StubEntities::update(const QString &entity_id, const QVariantMap &attributes) {
+    Q_UNUSED(entity_id);
+    Q_UNUSED(attributes);
+}
+
+bool StubEntities::addAvailableEntity(const QString &entity_id, const QString &type, const QString &integration,
+                                      const QString &friendly_name, const QStringList &supported_features) {
+    Q_UNUSED(type);
+    Q_UNUSED(integration);
+    Q_UNUSED(friendly_name);
+    Q_UNUSED(supported_features);
+    if (m_available.contains(entity_id)) {
+        return false;
+    }
+    m_available.append(entity_id);
+    return true;
+}
+
+QStringList StubEntities::supported_entities() {
+    return QStringList{"light", "blind", "media_player", "climate", "switch"};
+}
+
+bool StubEntities::remove(const QString &entityId) {
+    if (QThread::currentThread() != thread()) {
+        bool removed = false;
+        QMetaObject::invokeMethod(this, [&]() { removed = remove(entityId); }, Qt::BlockingQueuedConnection);
+        return removed;
+    }
+
+    StubEntity *entity = m_entities.take(entityId);
+    if (!entity) {
+        return false;
+    }
+    m_list.removeOne(entity);
+    m_available.removeOne(entityId);
+    delete entity;
+    return true;
+}
+
+bool StubYioApi::setConfig(QVariantMap config) {
+    Q_UNUSED(config);
+    return false;
+}
+
+bool StubYioApi::addEntityToConfig(QVariantMap entity) {
+    Q_UNUSED(entity);
+    return false;
+}
+
+bool StubYioApi::addEntity(QVariantMap entity) {
+    return m_entities->add(entity.value("type").toString(), entity, nullptr);
+}
+
+bool StubYioApi::removeEntity(QString entityId) {
+    return m_entities->remove(entityId);
+}
+
+void StubNotifications::add(bool type, const QString &text, const QString &actionlabel, void (*f)(QObject *),
+                            QObject *param) {
+    Q_UNUSED(actionlabel);
+    Q_UNUSED(f);
+    Q_UNUSED(param);
+    add(type, text);
+}
+
+void StubNotifications::add(bool type, const QString &text) {
+    m_count++;
+    if (type) {
+        m_errors++;
+    }
+    qWarning() << "Notification:" << text;
+}
@@ -0,0 +1,163 @@
+/******************************************************************************
+ *
+ * Copyright (C) 2019-2020 Marton Borzak <hello@martonborzak.com>
+ *
+ * This file is part of the YIO-Remote software project.
+ *
+ * YIO-Remote software is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * YIO-Remote software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with YIO-Remote software. If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *****************************************************************************/
+
+#pragma once
+
+#include <QHash>
+#include <QList>
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <QVariant>
+#include <QVector>
+
+#include "yio-interface/entities/entitiesinterface.h"
+#include "yio-interface/entities/entityinterface.h"
+#include "yio-interface/notificationsinterface.h"
+#include "yio-interface/yioapiinterface.h"
+
+// Entity of the stub entity model. Every feature is supported: the full capability mapping runs for each update.
+// Changes pushed by the integration are kept and reported with the changed signal.
+class StubEntity : public QObject, public EntityInterface {
+    Q_OBJECT
+
+ public:
+    explicit StubEntity(const QVariantMap& config, QObject* parent = nullptr);
+
+    QString     entity_id() override { return m_entityId; }
+    QString     type() override { return m_type; }
+    QString     integration() override { return m_integration; }
+    QString     area() override { return QString(); }
+    QString     friendly_name() override { return m_friendlyName; }
+    bool        favorite() override { return false; }
+    void        setFavorite(bool value) override { Q_UNUSED(value); }
+    QStringList supported_features() override { return m_supportedFeatures; }
+    QStringList custom_features() override { return QStringList(); }
+    QStringList allAttributes() override { return QStringList(); }
+    bool        isSupported(int feature) override;
+    int         state() override { return m_state; }
+    QString     stateText() override { return QString::number(m_state); }
+    QString     stateAsString() override { return QString::number(m_state); }
+    bool        setState(int state) override;
+    bool        isOn() override { return false; }
+    bool        supportsOn() override { return false; }
+    void        turnOn() override {}
+    void        turnOff() override {}
+    bool        updateAttrByName(const QString& attrName, const QVariant& value) override;
+    bool        updateAttrByIndex(int attrIndex, const QVariant& value) override;
+    void*       getSpecificInterface() override { return nullptr; }
+    QVariantMap getDataToSave() override { return QVariantMap(); }
+    bool        connected() override { return true; }
+    void        setConnected(bool value) override { Q_UNUSED(value); }
+
+    QVariant attribute(int attrIndex) const { return m_attributes.value(attrIndex); }
+    int      changes() const { return m_changes; }
+
+ signals:
+    // attribute index or -1 for the state
+    void changed(const QString& entityId, int attribute);
+
+ private:
+    QString           m_entityId;
+    QString           m_type;
+    QString           m_integration;
+    QString           m_friendlyName;
+    QStringList       m_supportedFeatures;
+    int               m_state = 0;
+    QVector<QVariant> m_attributes;
+    int               m_changes = 0;
+};
+
+// Entity model of the application: entities are created and removed through StubYioApi. Integrations in a worker
+// thread may add and remove entities, the entities are always created in the thread of the entity model.
+class StubEntities : public QObject, public EntitiesInterface {
+    Q_OBJECT
+
+ public:
+    explicit StubEntities(QObject* parent = nullptr) : QObject(parent) {}
+
+    QList<QObject*>         getByType(const QString& type) override;
+    QList<QObject*>         getByArea(const QString& area) override;
+    QList<QObject*>         getByAreaType(const QString& area, const QString& type) override;
+    QList<EntityInterface*> getByIntegration(const QString& integration) override;
+    QObject*                get(const QString& entity_id) override { return m_entities.value(entity_id); }
+    EntityInterface*        getEntityInterface(const QString& entity_id) override;
+    bool                    add(const QString& type, const QVariantMap& config, QObject* integrationObj) override;
+    void                    update(const QString& entity_id, const QVariantMap& attributes) override;
+    bool addAvailableEntity(const QString& entity_id, const QString& type, const QString& integration,
+                            const QString& friendly_name, const QStringList& supported_features) override;
+    QList<QObject*> mediaplayersPlaying() override { return QList<QObject*>(); }
+    void            addMediaplayersPlaying(const QString& entity_id) override { Q_UNUSED(entity_id); }
+    void            removeMediaplayersPlaying(const QString& entity_id) override { Q_UNUSED(entity_id); }
+    QStringList     supported_entities() override;
+    QStringList     supported_entities_translation() override { return supported_entities(); }
+    QStringList     loaded_entities() override { return m_entities.keys(); }
+    QString         getSupportedEntityTranslation(const QString& type) override { return type; }
+
+    bool remove(const QString& entityId);
+
+    QList<StubEntity*> entities() const { return m_list; }
+    int                availableEntities() const { return m_available.size(); }
+
+ signals:
+    void entityChanged(const QString& entityId, int attribute);
+
+ private:
+    QHash<QString, StubEntity*> m_entities;
+    QList<StubEntity*>          m_list;
+    QStringList                 m_available;
+};
+
+// Application API: entities added and removed by the integration go to the StubEntities.
+class StubYioApi : public YioAPIInterface {
+ public:
+    explicit StubYioApi(StubEntities* entities) : m_entities(entities) {}
+
+    void        sendMessage(QString message) override { Q_UNUSED(message); }
+    QVariantMap getConfig() override { return QVariantMap(); }
+    bool        setConfig(QVariantMap config) override;
+    bool        addEntityToConfig(QVariantMap entity) override;
+    void        discoverNetworkServices() override {}
+    void        discoverNetworkServices(QString mdns) override { Q_UNUSED(mdns); }
+    bool        addEntity(QVariantMap entity) override;
+    bool        removeEntity(QString entityId) override;
+
+ private:
+    StubEntities* m_entities;
+};
+
+// Notifications are counted and logged, actions are never triggered.
+class StubNotifications : public NotificationsInterface {
+ public:
+    void add(bool type, const QString& text, const QString& actionlabel, void (*f)(QObject*), QObject* param) override;
+    void add(bool type, const QString& text) override;
+    void add(const QString& text) override { add(false, text); }
+    void remove(int id) override { Q_UNUSED(id); }
+    void remove(const QString& text) override { Q_UNUSED(text); }
+    bool isThereError() override { return m_errors > 0; }
+
+    int count() const { return m_count; }
+
+ private:
+    int m_count = 0;
+    int m_errors = 0;
+};
@@ -0,0 +1,6 @@
+# Test and benchmark targets of the Homey integration. They run offline against stub YIO interfaces, the
+# integrations.library sources are required like for the plugin.
+TEMPLATE = subdirs
+
+SUBDIRS = bench_hotpaths \
+          bench_e2e